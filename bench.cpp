@@ -0,0 +1,270 @@
+#include "quickHull.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace corecvs;
+using namespace std;
+
+/* Workload benchmark: every run generates one distribution at one size, builds its hull and prints a JSON record
+   with the wall time, throughput, peak resident memory and hull size. Each run lives in its own child process so
+   that the peak resident set belongs to that run alone. */
+typedef void (*tWorkload)(tPointCloud &cloud, size_t count, mt19937 &generator);
+
+void addPoint(tPointCloud &cloud, double x, double y, double z) {
+    cloud.x.push_back(x);
+    cloud.y.push_back(y);
+    cloud.z.push_back(z);
+}
+
+void uniformCube(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    uniform_real_distribution<double> coord(-1, 1);
+    for (size_t i = 0; i < count; i++)
+        addPoint(cloud, coord(generator), coord(generator), coord(generator));
+}
+
+void uniformBall(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    uniform_real_distribution<double> coord(-1, 1);
+    while (cloud.x.size() < count) {
+        double x = coord(generator), y = coord(generator), z = coord(generator);
+        if (x * x + y * y + z * z <= 1)
+            addPoint(cloud, x, y, z);
+    }
+}
+
+void sphereSurface(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    normal_distribution<double> coord(0, 1);
+    while (cloud.x.size() < count) {
+        double x = coord(generator), y = coord(generator), z = coord(generator);
+        double norm = sqrt(x * x + y * y + z * z);
+        if (norm > 0)
+            addPoint(cloud, x / norm, y / norm, z / norm);
+    }
+}
+
+void gaussian(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    normal_distribution<double> coord(0, 1);
+    for (size_t i = 0; i < count; i++)
+        addPoint(cloud, coord(generator), coord(generator), coord(generator));
+}
+
+void clustered(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    const int clusters = 16;
+    uniform_real_distribution<double> centre(-1, 1);
+    normal_distribution<double> spread(0, 0.05);
+    double centres[clusters][3];
+    for (auto &c : centres)
+        for (auto &coord : c)
+            coord = centre(generator);
+    for (size_t i = 0; i < count; i++) {
+        const double *c = centres[i % clusters];
+        addPoint(cloud, c[0] + spread(generator), c[1] + spread(generator), c[2] + spread(generator));
+    }
+}
+
+void nearlyCoplanar(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    uniform_real_distribution<double> coord(-1, 1);
+    normal_distribution<double> noise(0, 1e-6);
+    for (size_t i = 0; i < count; i++) {
+        double x = coord(generator), y = coord(generator);
+        addPoint(cloud, x, y, 0.3 * x - 0.2 * y + noise(generator));
+    }
+}
+
+void integerGrid(tPointCloud &cloud, size_t count, mt19937 &) {
+    size_t side = (size_t)ceil(cbrt((double)count));
+    for (size_t i = 0; i < count; i++)
+        addPoint(cloud, (double)(i % side), (double)(i / side % side), (double)(i / side / side));
+}
+
+/* Re-scanned cube: every point is drawn from a pool of an eighth as many distinct points. */
+void duplicated(tPointCloud &cloud, size_t count, mt19937 &generator) {
+    uniformCube(cloud, (count + 7) / 8, generator);
+    uniform_int_distribution<size_t> pick(0, cloud.x.size() - 1);
+    while (cloud.x.size() < count) {
+        size_t i = pick(generator);
+        addPoint(cloud, cloud.x[i], cloud.y[i], cloud.z[i]);
+    }
+}
+
+typedef struct {
+    const char *name;
+    tWorkload generate;
+} tWorkloadEntry;
+
+const tWorkloadEntry workloads[] = {{"cube", uniformCube}, {"ball", uniformBall}, {"sphere", sphereSurface},
+                                    {"gaussian", gaussian}, {"clustered", clustered},
+                                    {"coplanar", nearlyCoplanar}, {"grid", integerGrid}, {"duplicated", duplicated}};
+
+typedef struct {
+    double seconds;
+    size_t vertices;
+    size_t faces;
+    size_t duplicatesRemoved;
+    tHullStats stats;
+} tRunResult;
+
+tRunResult runWorkload(const tWorkloadEntry &workload, size_t size, unsigned seed, unsigned repeat, double eps, const tQuickHullOptions &options) {
+    tPointCloud cloud;
+    mt19937 generator(seed);
+    cloud.x.reserve(size);
+    cloud.y.reserve(size);
+    cloud.z.reserve(size);
+    workload.generate(cloud, size, generator);
+    tRunResult result = {HUGE_VAL, 0, 0, 0, tHullStats()};
+    tQuickHullOptions runOptions = options;
+    runOptions.duplicatesRemoved = &result.duplicatesRemoved;
+    runOptions.stats = &result.stats;
+    for (unsigned r = 0; r < repeat; r++) {
+        auto start = chrono::steady_clock::now();
+        tHullMesh mesh;
+        bool built = buildHull(mesh, cloud, eps, runOptions);
+        result.seconds = min(result.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        result.faces = 0;
+        for (auto &face : mesh.faces)
+            if (!face.deleted)
+                result.faces++;
+        result.vertices = built ? meshVertices(mesh).size() : 0;
+    }
+    return result;
+}
+
+/* Runs the workload in a child and returns false if it did not finish; peakRssKb gets the child's peak. */
+bool measureWorkload(const tWorkloadEntry &workload, size_t size, unsigned seed, unsigned repeat, double eps, const tQuickHullOptions &options, tRunResult &result, long &peakRssKb) {
+    int channel[2];
+    if (pipe(channel) != 0)
+        return false;
+    pid_t child = fork();
+    if (child < 0)
+        return false;
+    if (child == 0) {
+        close(channel[0]);
+        tRunResult local = runWorkload(workload, size, seed, repeat, eps, options);
+        ssize_t written = write(channel[1], &local, sizeof(local));
+        _exit(written == sizeof(local) ? 0 : 1);
+    }
+    close(channel[1]);
+    ssize_t got = read(channel[0], &result, sizeof(result));
+    close(channel[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || got != sizeof(result))
+        return false;
+    peakRssKb = usage.ru_maxrss;
+    return true;
+}
+
+vector<string> splitList(const char *list) {
+    vector<string> items;
+    string item;
+    for (const char *c = list;; c++) {
+        if (*c == ',' || *c == 0) {
+            if (!item.empty())
+                items.push_back(item);
+            item.clear();
+            if (*c == 0)
+                break;
+        } else
+            item += *c;
+    }
+    return items;
+}
+
+void printUsage() {
+    printf("usage: quickHull_bench [--workloads cube,ball,sphere,gaussian,clustered,coplanar,grid,duplicated]\n"
+           "                       [--sizes 1e3,1e4,1e5,1e6,1e7,1e8] [--repeat N] [--threads N] [--eps E]\n"
+           "                       [--cull] [--concurrent] [--furthest-first] [--spatial-order]\n"
+           "                       [--dedup] [--dedup-tolerance T] [--seed S]\n");
+}
+
+int main(int argc, char **argv) {
+    vector<string> names;
+    for (auto &workload : workloads)
+        names.push_back(workload.name);
+    vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000, 100000000};
+    unsigned repeat = 3, seed = 1;
+    double eps = 1e-12;
+    tQuickHullOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--workloads") == 0 && hasValue)
+            names = splitList(argv[++i]);
+        else if (strcmp(argv[i], "--sizes") == 0 && hasValue) {
+            sizes.clear();
+            for (auto &size : splitList(argv[++i]))
+                sizes.push_back((size_t)atof(size.c_str()));
+        } else if (strcmp(argv[i], "--repeat") == 0 && hasValue)
+            repeat = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+            options.threads = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--eps") == 0 && hasValue)
+            eps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue)
+            seed = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cull") == 0)
+            options.cullInterior = true;
+        else if (strcmp(argv[i], "--concurrent") == 0)
+            options.concurrentExpansion = true;
+        else if (strcmp(argv[i], "--furthest-first") == 0)
+            options.furthestFirst = true;
+        else if (strcmp(argv[i], "--spatial-order") == 0)
+            options.spatialOrder = true;
+        else if (strcmp(argv[i], "--dedup") == 0)
+            options.removeDuplicates = true;
+        else if (strcmp(argv[i], "--dedup-tolerance") == 0 && hasValue) {
+            options.removeDuplicates = true;
+            options.duplicateTolerance = atof(argv[++i]);
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    printf("[\n");
+    bool first = true;
+    for (auto &name : names) {
+        const tWorkloadEntry *workload = nullptr;
+        for (auto &entry : workloads)
+            if (name == entry.name)
+                workload = &entry;
+        if (!workload) {
+            fprintf(stderr, "unknown workload %s\n", name.c_str());
+            continue;
+        }
+        for (auto size : sizes) {
+            tRunResult result;
+            long peak;
+            if (!measureWorkload(*workload, size, seed, repeat, eps, options, result, peak)) {
+                fprintf(stderr, "%s with %zu points did not finish\n", workload->name, size);
+                continue;
+            }
+            printf("%s  {\"workload\": \"%s\", \"points\": %zu, \"threads\": %u, \"cull\": %s, \"concurrent\": %s, "
+                   "\"schedule\": \"%s\", \"spatial_order\": %s, \"dedup\": %s, \"eps\": %g, \"seconds\": %.6f, \"points_per_second\": %.0f, "
+                   "\"peak_rss_kb\": %ld, \"hull_vertices\": %zu, \"hull_faces\": %zu",
+                   first ? "" : ",\n", workload->name, size, options.threads, options.cullInterior ? "true" : "false",
+                   options.concurrentExpansion ? "true" : "false", options.furthestFirst ? "furthest" : "fifo",
+                   options.spatialOrder ? "true" : "false", options.removeDuplicates ? "true" : "false", eps,
+                   result.seconds, size / result.seconds, peak, result.vertices, result.faces);
+            if (options.removeDuplicates)
+                printf(", \"duplicates_removed\": %zu", result.duplicatesRemoved);
+#ifdef QUICKHULL_STATS
+            printf(", \"iterations\": %llu, \"faces_created\": %llu, \"points_reassigned\": %llu, "
+                   "\"visibility_tests\": %llu", (unsigned long long)result.stats.iterations,
+                   (unsigned long long)result.stats.facesCreated, (unsigned long long)result.stats.pointsReassigned,
+                   (unsigned long long)result.stats.visibilityTests);
+#endif
+            printf("}");
+            first = false;
+            fflush(stdout);
+        }
+    }
+    printf("\n]\n");
+    return 0;
+}
@@ -1,217 +1,127 @@
+#include "quickHull.h"
 #include <algorithm>
-#include <array>
-#include "queue"
-#include "../corecvs/core/math/vector/vector3d.h"
-#include "../corecvs/core/geometry/polygons.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
 
 using namespace corecvs;
 using namespace std;
 
-typedef vector<Vector3dd> vertices;
+/* Calls of the global allocator, so tests can check that a code path does not allocate. Every replaceable form goes
+   through the same pair of functions, so each delete matches its new; the release stays out of line so GCC does
+   not pair an inlined free with operator new. */
+static atomic<size_t> allocations(0);
 
-typedef struct {
-    Triangle3dd plane;
-    vertices points;
-} tFace;
-
-bool operator ==(const Triangle3dd &a, const Triangle3dd &b) {
-    vector<Vector3dd> plane1 = { b.p1(), b.p2(), b.p3() };
-    auto findX = find(plane1.begin(), plane1.end(), a.p1());
-    auto findY = find(plane1.begin(), plane1.end(), a.p2());
-    auto findZ = find(plane1.begin(), plane1.end(), a.p3());
-    return (findX != plane1.end()) && (findY != plane1.end()) && (findZ != plane1.end());
-}
-bool operator !=(const Triangle3dd &a, const Triangle3dd &b) {
-    return !(a == b);
+static void *countedAllocate(size_t size) noexcept {
+    allocations++;
+    return malloc(size ? size : 1);
 }
 
-bool operator ==(const tFace &a, const tFace &b)
-{
-    return a.plane == b.plane;
+__attribute__((noinline)) static void countedRelease(void *memory) noexcept {
+    free(memory);
 }
 
-typedef vector<tFace> tFaces;
+void *operator new(size_t size) {
+    if (void *memory = countedAllocate(size))
+        return memory;
+    throw bad_alloc();
+}
 
-Vector3dd createVect(const Vector3dd &p1, const Vector3dd &p2) {
-    return { p2.x() - p1.x(), p2.y() - p1.y(), p2.z() - p1.z() };
+void *operator new[](size_t size) {
+    if (void *memory = countedAllocate(size))
+        return memory;
+    throw bad_alloc();
 }
 
-double vectMod (const Vector3dd &vect) {
-    return sqrt(pow(vect.x(), 2) + pow(vect.y(), 2) + pow(vect.z(), 2));
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    return countedAllocate(size);
 }
 
-double scalarProd(const Vector3dd &v1, const Vector3dd &v2) {
-    return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z();
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+    return countedAllocate(size);
 }
 
-Vector3dd vectProd(const Vector3dd &v1, const Vector3dd &v2){
-    return  { v1.y() * v2.z() - v1.z() * v2.y(), v1.z() * v2.x() - v1.x() * v2.z(), v1.x() * v2.y() - v1.y() * v2.x() };
+void operator delete(void *memory) noexcept {
+    countedRelease(memory);
 }
 
-double tripleProd(const Vector3dd &v1, const Vector3dd &v2, const Vector3dd &v3) {
-    return scalarProd(v1, vectProd(v2, v3));
+void operator delete[](void *memory) noexcept {
+    countedRelease(memory);
 }
 
-double pointDist(const Vector3dd &p1, const Vector3dd &p2) {
-    return vectMod(createVect(p1, p2));
+void operator delete(void *memory, size_t) noexcept {
+    countedRelease(memory);
 }
 
-double pointLineDist(const Vector3dd &lineP1, const Vector3dd &lineP2, const Vector3dd &point) {
-    Vector3dd lineVect = createVect(lineP1, lineP2);
-    return vectMod(vectProd(lineVect, createVect(lineP1, point))) / vectMod(lineVect);
+void operator delete[](void *memory, size_t) noexcept {
+    countedRelease(memory);
 }
 
-double pointPlaneDist(const Vector3dd &planeP1, const Vector3dd &planeP2, const Vector3dd &planeP3, const Vector3dd &point) {
-    Vector3dd baseV1 = createVect(planeP1, planeP2);
-    Vector3dd baseV2 = createVect(planeP1, planeP3);
-    return tripleProd(baseV1, baseV2, createVect(planeP1, point)) / vectMod(vectProd(baseV1, baseV2));
+void operator delete(void *memory, const nothrow_t &) noexcept {
+    countedRelease(memory);
 }
 
-vertices createSimplex(const vertices& listVertices) {
-    Vector3dd first = listVertices.front();
-    Vector3dd EP[6] = {first, first, first, first, first, first};
+void operator delete[](void *memory, const nothrow_t &) noexcept {
+    countedRelease(memory);
+}
 
-    for (auto vertex : listVertices) {
-        if (vertex.x() <= EP[0][0]) EP[0] = vertex;
-        if (vertex.x() >= EP[1][0]) EP[1] = vertex;
-        if (vertex.y() <= EP[2][1]) EP[2] = vertex;
-        if (vertex.y() >= EP[3][1]) EP[3] = vertex;
-        if (vertex.z() <= EP[4][2]) EP[4] = vertex;
-        if (vertex.z() >= EP[5][2]) EP[5] = vertex;
-    }
+#ifdef __cpp_aligned_new
+static void *countedAllocate(size_t size, align_val_t alignment) noexcept {
+    allocations++;
+    size_t align = (size_t)alignment;
+    return aligned_alloc(align, size ? (size + align - 1) / align * align : align);
+}
 
-    double maxDist = 0;
-    Vector3dd triangleP1 = EP[0], triangleP2 = EP[0], triangleP3 = EP[0];
-    for (auto point1 : EP)
-        for (auto point2 : EP) {
-            double dist = pointDist(point1, point2);
-            if (dist > maxDist) {
-                maxDist = dist;
-                triangleP1 = point1;
-                triangleP2 = point2;
-            }
-        }
+void *operator new(size_t size, align_val_t alignment) {
+    if (void *memory = countedAllocate(size, alignment))
+        return memory;
+    throw bad_alloc();
+}
 
-    maxDist = 0;
-    for (auto point : EP) {
-        double dist = pointLineDist(triangleP1, triangleP2, point);
-        if (dist > maxDist) {
-            maxDist = dist;
-            triangleP3 = point;
-        }
-    }
+void *operator new[](size_t size, align_val_t alignment) {
+    if (void *memory = countedAllocate(size, alignment))
+        return memory;
+    throw bad_alloc();
+}
 
-    maxDist = 0;
-    Vector3dd apex = EP[0];
-    for (auto point : listVertices) {
-        double dist = abs(pointPlaneDist(triangleP1, triangleP2, triangleP3, point));
-        if (dist > maxDist) {
-            maxDist = dist;
-            apex = point;
-        }
-    }
-    vertices Res;
-    if (pointPlaneDist(triangleP1, triangleP2, triangleP3, apex) > 0)
-         Res = { triangleP1, triangleP3, triangleP2, apex };
-    else Res = { triangleP1, triangleP2, triangleP3, apex };
-    return Res;
-};
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return countedAllocate(size, alignment);
+}
 
-double pointFaceDist(const Triangle3dd &face, const Vector3dd &point) {
-    return pointPlaneDist(face.p1(), face.p2(), face.p3(), point);
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    return countedAllocate(size, alignment);
 }
 
-bool faceIsVisible(const Vector3dd &eyePoint, const tFace &face, double eps) {
-    return pointFaceDist(face.plane, eyePoint) > eps;
+void operator delete(void *memory, align_val_t) noexcept {
+    countedRelease(memory);
 }
 
-void addPointsToFaces(tFace* faces, unsigned long faces_count, const vertices &listVertices, double eps) {
-    for (auto vertex : listVertices)
-        for (int i = 0; i < faces_count; i++) {
-            tFace face = faces[i];
-            if ((vertex != face.plane.p1()) && (vertex != face.plane.p2()) && (vertex != face.plane.p3()) && faceIsVisible(vertex, face, eps)) {
-                faces[i].points.push_back(vertex);
-                break;
-            }
-        }
+void operator delete[](void *memory, align_val_t) noexcept {
+    countedRelease(memory);
 }
 
-tFaces quickHull(const vertices& listVertices, double epsilon) {
-    queue<tFace> Queue;
-    vertices simplex = createSimplex(listVertices);
-    vertices uniqueSimplex;
-    for (auto elem : simplex)
-        if (find(uniqueSimplex.begin(), uniqueSimplex.end(), elem) == uniqueSimplex.end())
-            uniqueSimplex.push_back(elem);
-    if (uniqueSimplex.size() == 1) {
-        printf("Only one unique point\n");
-        return {};
-    }
+void operator delete(void *memory, size_t, align_val_t) noexcept {
+    countedRelease(memory);
+}
 
-    if (uniqueSimplex.size() == 2) {
-        printf("This is line\n");
-        return {};
-    }
+void operator delete[](void *memory, size_t, align_val_t) noexcept {
+    countedRelease(memory);
+}
 
-    if (uniqueSimplex.size() == 3) {
-        printf("This is plane\n");
-        return {};
-    }
+void operator delete(void *memory, align_val_t, const nothrow_t &) noexcept {
+    countedRelease(memory);
+}
 
-    tFaces faces = {{{simplex[0], simplex[1], simplex[2]}},
-                    {{simplex[0], simplex[2], simplex[3]}},
-                    {{simplex[1], simplex[3], simplex[2]}},
-                    {{simplex[0], simplex[3], simplex[1]}}};
-    addPointsToFaces(faces.data(), faces.size(), listVertices, epsilon);
-    for (auto face : faces)
-        if (!face.points.empty()) Queue.push(face);
-
-    while (!Queue.empty()) {
-        tFace face = Queue.front();
-        Queue.pop();
-        if (!face.points.empty()) {
-            double maxDist = -1;
-            Vector3dd furthest = {0, 0, 0};
-            for (auto point : face.points) {
-                double dist = pointFaceDist(face.plane, point);
-                if (dist > maxDist) {
-                    maxDist = dist;
-                    furthest = point;
-                }
-            }
-
-            vertices listUnclaimedVertices;
-            tFaces newFaces;
-            tFaces needToDelete;
-            for (auto curFace : faces)
-                if (faceIsVisible(furthest, curFace, epsilon)) {
-                    for (auto point : curFace.points)
-                        listUnclaimedVertices.push_back(point);
-                    tFaces tmpFaces = {{{curFace.plane.p3(), furthest, curFace.plane.p2()}},
-                                       {{curFace.plane.p1(), curFace.plane.p2(), furthest}},
-                                       {{curFace.plane.p1(), furthest, curFace.plane.p3()}}};
-                    for (auto &tmpFace : tmpFaces) {
-                        auto alreadyExists = find(newFaces.begin(), newFaces.end(), tmpFace);
-                        if (alreadyExists != newFaces.end())
-                            newFaces.erase(alreadyExists);
-                        else
-                            newFaces.push_back(tmpFace);
-                    }
-                    needToDelete.push_back(curFace);
-                }
-
-            for (auto &iter : needToDelete)
-                faces.erase(remove(faces.begin(), faces.end(), iter), faces.end());
-
-            addPointsToFaces(newFaces.data(), newFaces.size(), listUnclaimedVertices, epsilon);
-            for (auto &newFace : newFaces) {
-                faces.push_back(newFace);
-                Queue.push(newFace);
-            }
-        }
-    }
-    return faces;
-};
+void operator delete[](void *memory, align_val_t, const nothrow_t &) noexcept {
+    countedRelease(memory);
+}
+#endif
 
 void testHull(const vertices &verts, const tFaces &goldValue) {
     double eps = 0.00001;
@@ -220,8 +130,8 @@ void testHull(const vertices &verts, const tFaces &goldValue) {
     if (faces.size() != goldValue.size())
         test = false;
     else {
-        for (int i = 0; i < goldValue.size(); i++)
-            if (goldValue[i].plane != faces[i].plane)
+        for (auto &goldFace : goldValue)
+            if (find(faces.begin(), faces.end(), goldFace) == faces.end())
                 test = false;
     }
     int i = 0;
@@ -240,7 +150,512 @@ void testHull(const vertices &verts, const tFaces &goldValue) {
 }
 
 
-int main() {
+void testSameHull(const tFaces &faces, const tFaces &goldValue) {
+    bool test = faces.size() == goldValue.size();
+    for (auto &goldFace : goldValue)
+        if (find(faces.begin(), faces.end(), goldFace) == faces.end())
+            test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)faces.size());
+}
+
+void testParallelHull(const vertices &verts, unsigned threads) {
+    double eps = 0.00001;
+    testSameHull(quickHullParallel(verts, eps, threads), quickHull(verts, eps));
+}
+
+/* The faces depend on the order the points are added in, so only check that the hull is closed and convex. */
+void testValidHull(const vertices &verts, const tFaces &faces) {
+    double eps = 0.00001;
+    map<array<double, 6>, int> edges;
+    bool test = true;
+    for (auto &face : faces) {
+        Vector3dd p[3] = { face.plane.p1(), face.plane.p2(), face.plane.p3() };
+        for (int i = 0; i < 3; i++)
+            edges[{p[i].x(), p[i].y(), p[i].z(), p[(i + 1) % 3].x(), p[(i + 1) % 3].y(), p[(i + 1) % 3].z()}]++;
+        for (auto &vertex : verts)
+            if (pointPlaneDist(p[0], p[1], p[2], vertex) > 10 * eps)
+                test = false;
+    }
+    for (auto &edge : edges)
+        if (edge.second != 1 || edges.count({edge.first[3], edge.first[4], edge.first[5],
+                                             edge.first[0], edge.first[1], edge.first[2]}) == 0)
+            test = false;
+    if (faces.empty())
+        test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)faces.size());
+}
+
+void testConcurrentHull(const vertices &verts, unsigned threads) {
+    double eps = 0.00001;
+    tQuickHullOptions options;
+    options.threads = threads;
+    options.concurrentExpansion = true;
+    testValidHull(verts, quickHull(verts, eps, options));
+}
+
+bool samePoints(const vertices &a, const vertices &b) {
+    if (a.size() != b.size())
+        return false;
+    for (auto &point : b)
+        if (find(a.begin(), a.end(), point) == a.end())
+            return false;
+    return true;
+}
+
+void testDegenerateHull(const vertices &verts, tHullKind kind, const vertices &goldValue) {
+    double eps = 0.00001;
+    tHull hull = convexHull(verts, eps);
+    bool test = hull.kind == kind && samePoints(hull.points, goldValue);
+    for (size_t i = 0; kind == hullPolygon && i < hull.points.size(); i++) {
+        const Vector3dd &a = hull.points[i], &b = hull.points[(i + 1) % hull.points.size()], &c = hull.points[(i + 2) % hull.points.size()];
+        if (scalarProd(vectProd(createVect(a, b), createVect(b, c)), hull.normal) <= 0)
+            test = false;
+    }
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of points: %i\n", (int)hull.points.size());
+}
+
+void testFurthestFirstHull(const vertices &verts) {
+    double eps = 0.00001;
+    tQuickHullOptions options;
+    options.furthestFirst = true;
+    testValidHull(verts, quickHull(verts, eps, options));
+}
+
+/* The partial hull must be a closed triangulated sphere, within the tolerance unless the vertex budget ran out. */
+void testApproximateHull(const vertices &verts, double tolerance, size_t maxVertices) {
+    double eps = 0.00001;
+    tApproximateHull hull = approximateHull(verts, eps, tolerance, maxVertices);
+    bool test = !hull.faces.empty() && hull.vertexCount == hull.faces.size() / 2 + 2 && hull.error > 0;
+    if (tolerance > 0 && hull.error > tolerance && (!maxVertices || hull.vertexCount < maxVertices))
+        test = false;
+    if (maxVertices && hull.vertexCount > maxVertices)
+        test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i, error %f\n", (int)hull.faces.size(), hull.error);
+}
+
+/* Faces come back in the caller's indices, so the hull is checked against the unsorted points. */
+void testSpatialOrderHull(const vertices &verts, bool cull) {
+    double eps = 0.00001;
+    tQuickHullOptions options;
+    options.spatialOrder = true;
+    options.cullInterior = cull;
+    testValidHull(verts, quickHull(verts, eps, options));
+}
+
+/* Every point must map to an earlier kept point of its grid cell, or of its exact copies when tolerance is 0. */
+template <typename tCoord>
+bool validSurvivors(const tPointCloudOf<tCoord> &cloud, double tolerance, const tPointIds &survivorOf) {
+    if (survivorOf.size() != cloud.x.size())
+        return false;
+    for (size_t i = 0; i < survivorOf.size(); i++) {
+        uint32_t survivor = survivorOf[i];
+        if (survivor > i || survivorOf[survivor] != survivor)
+            return false;
+        double a[3] = {(double)cloud.x[i], (double)cloud.y[i], (double)cloud.z[i]};
+        double b[3] = {(double)cloud.x[survivor], (double)cloud.y[survivor], (double)cloud.z[survivor]};
+        for (int k = 0; k < 3; k++)
+            if (tolerance > 0 ? floor(a[k] * (1 / tolerance)) != floor(b[k] * (1 / tolerance)) : a[k] != b[k])
+                return false;
+    }
+    return true;
+}
+
+/* Every point must map to the first kept point of its cell, the hull built with duplicate removal must match the
+   plain one and report the same removals, and convexHull and a culled float32 build must honour the option too. */
+void testDuplicateHull(const vertices &verts, double tolerance, size_t removed) {
+    double eps = 0.00001;
+    tPointIds survivorOf;
+    tPointIds kept = removeDuplicatePoints(makePointCloud(verts), tolerance, survivorOf, 3);
+    bool test = verts.size() - kept.size() == removed && validSurvivors(makePointCloud(verts), tolerance, survivorOf);
+    tQuickHullOptions options;
+    options.removeDuplicates = true;
+    options.duplicateTolerance = tolerance;
+    size_t removedInBuild = 0;
+    tPointIds survivorOfInBuild;
+    options.duplicatesRemoved = &removedInBuild;
+    options.duplicateSurvivors = &survivorOfInBuild;
+    tFaces faces = quickHull(verts, eps, options);
+    if (removedInBuild != removed || survivorOfInBuild != survivorOf)
+        test = false;
+    tPointCloudOf<float> floatCloud;
+    for (auto &point : verts) {
+        floatCloud.x.push_back((float)point.x());
+        floatCloud.y.push_back((float)point.y());
+        floatCloud.z.push_back((float)point.z());
+    }
+    tQuickHullOptions floatOptions = options;
+    floatOptions.cullInterior = true;
+    quickHull(floatCloud, eps, floatOptions);
+    if (removedInBuild > removed || !validSurvivors(floatCloud, tolerance, survivorOfInBuild))
+        test = false;
+    options.duplicatesRemoved = nullptr;
+    options.duplicateSurvivors = nullptr;
+    tFaces goldValue = quickHull(verts, eps);
+    if (tolerance == 0 && faces.size() != goldValue.size())
+        test = false;
+    tHull hull = convexHull(verts, eps, options);
+    if (hull.kind != hullPolyhedron || hull.faces.size() != faces.size())
+        test = false;
+    for (auto &face : faces)
+        if (find(hull.faces.begin(), hull.faces.end(), face) == hull.faces.end())
+            test = false;
+    for (auto &goldFace : goldValue)
+        if (tolerance == 0 && find(faces.begin(), faces.end(), goldFace) == faces.end())
+            test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of points removed: %i, number of facets: %i\n", (int)(verts.size() - kept.size()), (int)faces.size());
+}
+
+/* The indexed hull must expand to the same faces as quickHull, with consistent normals and mutual adjacency. */
+void testIndexedHull(const vertices &verts) {
+    double eps = 0.00001;
+    tIndexedHull hull = quickHullIndexed(verts, eps, true, true);
+    tFaces goldValue = quickHull(verts, eps);
+    size_t count = hull.triangles.size() / 3;
+    bool test = count == goldValue.size() && hull.normals.size() == count && hull.adjacent.size() == 3 * count &&
+                hull.points.size() == count / 2 + 2 && hull.inputIds.size() == hull.points.size();
+    for (size_t i = 0; test && i < hull.points.size(); i++)
+        if (!(hull.points[i] == verts[hull.inputIds[i]]))
+            test = false;
+    tFaces faces;
+    for (size_t f = 0; test && f < count; f++) {
+        const uint32_t *t = &hull.triangles[3 * f];
+        faces.push_back({{hull.points[t[0]], hull.points[t[1]], hull.points[t[2]]}, {}});
+        Vector3dd normal = vectProd(createVect(hull.points[t[0]], hull.points[t[1]]), createVect(hull.points[t[0]], hull.points[t[2]]));
+        if (scalarProd(normal, hull.normals[f]) <= 0)
+            test = false;
+        for (int i = 0; i < 3; i++) {
+            const uint32_t *twin = &hull.triangles[3 * hull.adjacent[3 * f + i]];
+            bool shared = false;
+            for (int j = 0; j < 3; j++)
+                if (twin[j] == t[(i + 1) % 3] && twin[(j + 1) % 3] == t[i] && hull.adjacent[3 * hull.adjacent[3 * f + i] + j] == f)
+                    shared = true;
+            test = test && shared;
+        }
+    }
+    for (auto &goldFace : goldValue)
+        if (find(faces.begin(), faces.end(), goldFace) == faces.end())
+            test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)count);
+}
+
+void testExactHull(const vertices &verts) {
+    testValidHull(verts, quickHull(verts, 0));
+}
+
+/* Every partition kernel this CPU can run must keep and move the same points in the same order and pick the same
+   furthest point as the scalar one. On grid points many distances tie exactly, so any extra rounding shows. */
+void testPartitionKernels(const vertices &verts, unsigned trials) {
+    double eps = 0.00001;
+    tPointCloud cloud = makePointCloud(verts);
+    vector<tPartitionKernel> kernels;
+#ifdef QUICKHULL_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back(partitionPointsAvx2);
+    if (__builtin_cpu_supports("avx512f"))
+        kernels.push_back(partitionPointsAvx512);
+#endif
+    mt19937 generator(trials);
+    uniform_int_distribution<uint32_t> pick(0, (uint32_t)verts.size() - 1);
+    tPointIds all(verts.size());
+    for (uint32_t i = 0; i < all.size(); i++)
+        all[i] = i;
+    bool test = true;
+    for (unsigned trial = 0; trial < trials; trial++) {
+        uint32_t p1 = pick(generator), p2 = pick(generator), p3 = pick(generator);
+        tMeshFace gold;
+        initMeshFace(gold, cloud, p1, p2, p3);
+        tPointIds goldRest = all;
+        size_t goldCount = partitionPointsScalar(cloud, gold, eps, goldRest.data(), goldRest.size());
+        for (auto kernel : kernels) {
+            tMeshFace face;
+            initMeshFace(face, cloud, p1, p2, p3);
+            tPointIds rest = all;
+            size_t count = kernel(cloud, face, eps, rest.data(), rest.size());
+            if (count != goldCount || !equal(rest.begin(), rest.begin() + count, goldRest.begin()) ||
+                    face.points != gold.points || face.furthest != gold.furthest || face.furthestDist != gold.furthestDist)
+                test = false;
+        }
+    }
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of SIMD kernels: %i\n", (int)kernels.size());
+}
+
+#ifdef QUICKHULL_STATS
+/* Every face ever created is either still on the hull or was deleted. */
+void testHullStats(const vertices &verts, bool concurrent) {
+    double eps = 0.00001;
+    tHullStats stats;
+    tQuickHullOptions options;
+    options.threads = concurrent ? 3 : 1;
+    options.concurrentExpansion = concurrent;
+    options.stats = &stats;
+    tFaces faces = quickHull(verts, eps, options);
+    bool test = stats.facesCreated - stats.facesDeleted == faces.size() && stats.iterations > 0 &&
+                stats.maxConflictList > 0 && stats.maxConflictList <= verts.size() && stats.pointsReassigned > 0 &&
+                stats.visibilityTests >= verts.size() && stats.horizonNs > 0 && stats.redistributeNs > 0;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)faces.size());
+    printf("iterations %llu, visibility tests %llu, faces %llu/%llu, reassigned %llu, longest list %llu\n",
+           (unsigned long long)stats.iterations, (unsigned long long)stats.visibilityTests,
+           (unsigned long long)stats.facesCreated, (unsigned long long)stats.facesDeleted,
+           (unsigned long long)stats.pointsReassigned, (unsigned long long)stats.maxConflictList);
+    printf("simplex %.3f ms, partition %.3f ms, horizon %.3f ms, cone %.3f ms, redistribution %.3f ms\n",
+           stats.simplexNs * 1e-6, stats.partitionNs * 1e-6, stats.horizonNs * 1e-6, stats.coneNs * 1e-6,
+           stats.redistributeNs * 1e-6);
+}
+#endif
+
+void testIncrementalHull(const vertices &verts, size_t batchSize) {
+    double eps = 0.00001;
+    tIncrementalHull hull(eps);
+    for (size_t begin = 0; begin < verts.size(); begin += batchSize)
+        insertBatch(hull, vertices(verts.begin() + begin, verts.begin() + min(verts.size(), begin + batchSize)));
+    testValidHull(verts, incrementalHullFaces(hull));
+}
+
+/* Every step must give the hull of the live window, both when the merged hull only grew and when it lost a vertex. */
+void testDynamicHull(const vertices &verts, size_t window, size_t step) {
+    double eps = 0.00001;
+    tDynamicHull hull(eps, 1024);
+    bool test = true;
+    for (size_t begin = 0; begin < verts.size(); begin += step) {
+        size_t end = min(verts.size(), begin + step);
+        slideWindow(hull, vertices(verts.begin() + begin, verts.begin() + end), window);
+        const tFaces &faces = dynamicHullFaces(hull);
+        tFaces goldValue = quickHull(vertices(verts.begin() + (end > window ? end - window : 0), verts.begin() + end), eps);
+        if (faces.size() != goldValue.size())
+            test = false;
+        for (auto &goldFace : goldValue)
+            if (find(faces.begin(), faces.end(), goldFace) == faces.end())
+                test = false;
+    }
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)dynamicHullFaces(hull).size());
+}
+
+template <typename tCoord>
+void testFileHull(const vertices &verts) {
+    double eps = 0.00001;
+    const char *path = "quickHullTest.xyz";
+    vector<tCoord> data;
+    tPointCloudOf<tCoord> cloud;
+    for (auto &vertex : verts) {
+        tCoord point[3] = { (tCoord)vertex.x(), (tCoord)vertex.y(), (tCoord)vertex.z() };
+        data.insert(data.end(), point, point + 3);
+        cloud.x.push_back(point[0]);
+        cloud.y.push_back(point[1]);
+        cloud.z.push_back(point[2]);
+    }
+    FILE *file = fopen(path, "wb");
+    fwrite(data.data(), sizeof(tCoord), data.size(), file);
+    fclose(file);
+    tQuickHullOptions options;
+    options.cullInterior = true;
+    tFaces faces;
+    quickHullFile<tCoord>(path, eps, faces);
+    testSameHull(faces, quickHull(cloud, eps, options));
+    remove(path);
+}
+
+/* A missing file and one cut in the middle of a point must fail with errno rather than give an empty hull. */
+void testBadHullFile() {
+    double eps = 0.00001;
+    const char *path = "quickHullTest.xyz";
+    tFaces faces;
+    bool test = !quickHullFile<double>(path, eps, faces) && errno == ENOENT;
+    double data[4] = {0, 0, 0, 1};
+    FILE *file = fopen(path, "wb");
+    fwrite(data, sizeof(double), 4, file);
+    fclose(file);
+    test = test && !quickHullFile<double>(path, eps, faces) && errno == EINVAL && faces.empty();
+    remove(path);
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+}
+
+void testFloatHull(const vertices &verts, bool cull) {
+    double eps = 0.00001;
+    tPointCloudOf<float> cloud;
+    tPointCloud stored;
+    for (auto &vertex : verts) {
+        cloud.x.push_back((float)vertex.x());
+        cloud.y.push_back((float)vertex.y());
+        cloud.z.push_back((float)vertex.z());
+        stored.x.push_back(cloud.x.back());
+        stored.y.push_back(cloud.y.back());
+        stored.z.push_back(cloud.z.back());
+    }
+    tQuickHullOptions options;
+    options.cullInterior = cull;
+    testSameHull(quickHull(cloud, eps, options), quickHull(stored, eps, options));
+}
+
+vertices randomCube(size_t count, unsigned seed) {
+    mt19937 generator(seed);
+    uniform_real_distribution<double> coord(-1, 1);
+    vertices verts(count);
+    for (auto &vertex : verts)
+        vertex = {coord(generator), coord(generator), coord(generator)};
+    return verts;
+}
+
+vertices randomSphere(size_t count, unsigned seed) {
+    mt19937 generator(seed);
+    normal_distribution<double> coord(0, 1);
+    vertices verts(count);
+    for (auto &vertex : verts) {
+        Vector3dd direction = {coord(generator), coord(generator), coord(generator)};
+        double length = vectMod(direction);
+        vertex = {direction.x() / length, direction.y() / length, direction.z() / length};
+    }
+    return verts;
+}
+
+/* A 10 x 10 x 0.01 box whose top bulges by 0.001, then points no more than 5e-6 above the top but up to 3e-3 past
+   its x = 5 side. The locating walk ends on a top face they only graze, far from the side they leave. */
+void testThinBoxIncrementalHull(size_t count, size_t late, unsigned seeds) {
+    auto top = [](double x, double y) { return 0.01 + 0.001 * (1 - (x * x + y * y) / 50); };
+    for (unsigned seed = 0; seed < seeds; seed++) {
+        vertices verts;
+        for (auto &point : randomCube(count, seed)) {
+            double x = 5 * point.x(), y = 5 * point.y();
+            verts.push_back({x, y, verts.size() % 2 == 0 ? 0.005 + 0.005 * point.z() : verts.size() % 4 == 1 ? top(x, y) : 0});
+        }
+        for (int corner = 0; corner < 8; corner++)
+            verts[corner] = {corner & 1 ? 5.0 : -5.0, corner & 2 ? 5.0 : -5.0, corner & 4 ? 0.01 : 0};
+        mt19937 generator(seed + 1000);
+        uniform_real_distribution<double> unit(0, 1);
+        for (size_t k = 0; k < late; k++) {
+            double x = 5 + 0.003 * unit(generator), y = 10 * unit(generator) - 5;
+            verts.push_back({x, y, top(5, y) + 0.000005 * unit(generator)});
+        }
+        testIncrementalHull(verts, count);
+    }
+}
+
+/* One workspace hulls every input; a second pass over the same inputs must not grow its face pool. */
+void testHullWorkspace(const vector<vertices> &inputs, double eps) {
+    tHullWorkspace workspace;
+    bool test = true;
+    size_t total = 0;
+    for (auto &verts : inputs) {
+        tFaces goldValue = quickHull(verts, eps);
+        const tFaces &faces = quickHull(workspace, verts, eps);
+        if (faces.size() != goldValue.size())
+            test = false;
+        for (auto &goldFace : goldValue)
+            if (find(faces.begin(), faces.end(), goldFace) == faces.end())
+                test = false;
+        total += faces.size();
+    }
+    size_t before = allocations;
+    for (auto &verts : inputs)
+        quickHull(workspace, verts, eps);
+    if (allocations != before)
+        test = false;
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)total);
+}
+
+/* Objects of 20 to 2000 points, alternately from a cube and a sphere, each compared with its own quickHull. */
+void testHullBatch(size_t objects, unsigned threads, unsigned seed) {
+    double eps = 0.00001;
+    mt19937 generator(seed);
+    uniform_int_distribution<size_t> size(20, 2000);
+    vector<vertices> sets;
+    vertices all;
+    vector<size_t> offsets = {0};
+    for (size_t k = 0; k < objects; k++) {
+        sets.push_back(k % 2 ? randomCube(size(generator), seed + (unsigned)k) : randomSphere(size(generator), seed + (unsigned)k));
+        all.insert(all.end(), sets.back().begin(), sets.back().end());
+        offsets.push_back(all.size());
+    }
+    tPointCloud cloud = makePointCloud(all);
+    tHullPool pool(threads);
+    tHullBatch batch;
+    quickHullBatch(pool, cloud, offsets, eps, batch);
+    bool test = true;
+    size_t total = 0;
+    for (size_t k = 0; k < objects; k++) {
+        tFaces faces;
+        const uint32_t *triangle = batch.triangles.data() + 3 * batch.faceBegin[k];
+        for (uint32_t f = 0; f < batch.faceCount[k]; f++, triangle += 3)
+            faces.push_back({{cloudPoint(cloud, triangle[0]), cloudPoint(cloud, triangle[1]), cloudPoint(cloud, triangle[2])}, {}});
+        tFaces goldValue = quickHull(sets[k], eps);
+        if (faces.size() != goldValue.size())
+            test = false;
+        for (auto &goldFace : goldValue)
+            if (find(faces.begin(), faces.end(), goldFace) == faces.end())
+                test = false;
+        total += faces.size();
+    }
+    if (test)
+        printf("test completed\n");
+    else
+        printf("test failed\n");
+    printf("number of facets: %i\n", (int)total);
+}
+
+void benchParallelScaling(size_t count, unsigned maxThreads) {
+    vertices verts = randomCube(count, 1);
+    double baseTime = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        auto start = chrono::steady_clock::now();
+        tFaces faces = quickHullParallel(verts, 0.00001, threads);
+        double time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+            baseTime = time;
+        printf("threads: %u time: %.3f s speedup: %.2f facets: %i\n", threads, time, baseTime / time, (int)faces.size());
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && string(argv[1]) == "--bench-parallel") {
+        size_t count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000000;
+        unsigned maxThreads = argc > 3 ? (unsigned)strtoul(argv[3], nullptr, 10) : max(thread::hardware_concurrency(), 1u);
+        benchParallelScaling(count, maxThreads);
+        return 0;
+    }
+
     printf("First test: one point\n");
     vertices verts = {{1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}, {1,0,0}};
     tFaces goldValue = {};
@@ -265,5 +680,90 @@ int main() {
     verts = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 2}};
     goldValue = {{{(Vector3dd){0, 0, 2}, {1, 0, 0}, {0, 1, 0}}}, {{(Vector3dd){0, 0, 2}, {0, 1, 0}, {0, 0, 0}}}, {{(Vector3dd){1, 0, 0}, {0, 0, 0}, {0, 1, 0}}}, {{(Vector3dd){0, 0, 2}, {0, 0, 0}, {1, 0, 0}}}};
     testHull(verts, goldValue);
+    printf("\nSeventh test: parallel hull of a random cube\n");
+    testParallelHull(randomCube(20000, 7), 4);
+    printf("\nEighth test: parallel hull of points on a sphere\n");
+    testParallelHull(randomSphere(500, 8), 3);
+    printf("\nNinth test: concurrent expansion of a random cube\n");
+    testConcurrentHull(randomCube(200000, 9), 3);
+    printf("\nTenth test: a random cube inserted in batches, then a thin box grown past its side just above its top\n");
+    testIncrementalHull(randomCube(200000, 10), 10000);
+    testThinBoxIncrementalHull(2000, 200, 10);
+    printf("\nEleventh test: sliding window over a random cube\n");
+    testDynamicHull(randomCube(60000, 11), 20000, 5000);
+    testDynamicHull(randomCube(30000, 12), 10000, 250);
+    printf("\nTwelfth test: random cubes read from float64 and float32 files, and unreadable files\n");
+    testFileHull<double>(randomCube(3000000, 12));
+    testFileHull<float>(randomCube(100000, 12));
+    testBadHullFile();
+    printf("\nThirteenth test: float32 clouds of random cubes with and without culling\n");
+    testFloatHull(randomCube(1000000, 13), true);
+    testFloatHull(randomCube(100000, 13), false);
+    printf("\nFourteenth test: exact hull of sphere points snapped to a grid\n");
+    verts = randomSphere(20000, 14);
+    for (auto &vertex : verts)
+        vertex = {round(vertex.x() * 64) / 64, round(vertex.y() * 64) / 64, round(vertex.z() * 64) / 64};
+    testExactHull(verts);
+    printf("\nFifteenth test: point, segment, tilted square and solids whose extremes lie on one diagonal\n");
+    testDegenerateHull({{1, 0, 0}, {1, 0, 0}}, hullPoint, {{1, 0, 0}});
+    testDegenerateHull({{1, 0, 0}, {2, 0, 0}, {3, 0, 0}, {1, 0, 0}}, hullSegment, {{1, 0, 0}, {3, 0, 0}});
+    verts.clear();
+    for (int i = 0; i <= 10; i++)
+        for (int j = 0; j <= 10; j++)
+            verts.push_back({(double)i, (double)j, 3.0 * i - 7.0 * j});
+    testDegenerateHull(verts, hullPolygon, {{0, 0, 0}, {10, 0, 30}, {0, 10, -70}, {10, 10, -40}});
+    verts = {{0, 0, 0}, {1, 1, 1}, {0.5, 0.6, 0.4}, {0.2, 0.3, 0.3}};
+    testDegenerateHull(verts, hullPolyhedron, {});
+    testValidHull(verts, quickHull(verts, 0.00001));
+    verts = randomCube(998, 15);
+    for (auto &vertex : verts)
+        vertex = {0.5 + 0.4 * vertex.x(), 0.5 + 0.4 * vertex.y(), 0.5 + 0.4 * vertex.z()};
+    verts.push_back({0, 0, 0});
+    verts.push_back({1, 1, 1});
+    testValidHull(verts, quickHull(verts, 0.00001));
+    printf("\nSixteenth test: furthest-first order on a random cube and on sphere points\n");
+    testFurthestFirstHull(randomCube(200000, 17));
+    testFurthestFirstHull(randomSphere(20000, 17));
+    printf("\nSeventeenth test: sphere points approximated to a tolerance and to a vertex budget\n");
+    testApproximateHull(randomSphere(20000, 18), 0.01, 0);
+    testApproximateHull(randomSphere(20000, 18), 0, 100);
+    testApproximateHull(randomCube(200000, 18), 0.001, 50);
+    printf("\nEighteenth test: a batch of small hulls on a thread pool\n");
+    testHullBatch(500, 3, 19);
+    printf("\nNineteenth test: one workspace reused for cubes and spheres, then exactly for grid-snapped points\n");
+    testHullWorkspace({randomCube(20000, 20), randomSphere(2000, 20), randomCube(500, 21), randomSphere(3000, 21)}, 0.00001);
+    verts = randomSphere(5000, 20);
+    for (auto &vertex : verts)
+        vertex = {round(vertex.x() * 64) / 64, round(vertex.y() * 64) / 64, round(vertex.z() * 64) / 64};
+    testHullWorkspace({verts, randomCube(20000, 21)}, 0);
+    printf("\nTwentieth test: Morton-ordered random cube and sphere points\n");
+    testSpatialOrderHull(randomCube(200000, 22), true);
+    testSpatialOrderHull(randomSphere(20000, 22), false);
+    printf("\nTwenty-first test: indexed hull of a random cube and of sphere points\n");
+    testIndexedHull(randomCube(100000, 23));
+    testIndexedHull(randomSphere(5000, 23));
+    printf("\nTwenty-second test: a random cube scanned four times and jittered points on a grid\n");
+    verts = randomCube(20000, 24);
+    for (int copy = 0; copy < 3; copy++)
+        verts.insert(verts.end(), verts.begin(), verts.begin() + 20000);
+    shuffle(verts.begin(), verts.end(), mt19937(24));
+    testDuplicateHull(verts, 0, 60000);
+    verts.clear();
+    for (auto &jitter : randomCube(5000, 25)) {
+        size_t cell = verts.size() % 1000;
+        verts.push_back({(cell % 10 + 0.5 + 0.3 * jitter.x()) * 0.1, (cell / 10 % 10 + 0.5 + 0.3 * jitter.y()) * 0.1,
+                         (cell / 100 + 0.5 + 0.3 * jitter.z()) * 0.1});
+    }
+    testDuplicateHull(verts, 0.1, 4000);
+    printf("\nTwenty-third test: every partition kernel on random cube points snapped to a grid\n");
+    verts = randomCube(4099, 26);
+    for (auto &vertex : verts)
+        vertex = {round(vertex.x() * 64) / 64, round(vertex.y() * 64) / 64, round(vertex.z() * 64) / 64};
+    testPartitionKernels(verts, 500);
+#ifdef QUICKHULL_STATS
+    printf("\nTwenty-fourth test: phase statistics of sphere points and of a concurrent random cube\n");
+    testHullStats(randomSphere(20000, 16), false);
+    testHullStats(randomCube(200000, 16), true);
+#endif
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,2795 @@
+#ifndef QUICKHULL_H
+#define QUICKHULL_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUICKHULL_X86_SIMD
+#include <immintrin.h>
+#endif
+/* The partition kernels must round every distance alike, so GCC may not fuse their multiply-adds into FMA even where
+   the target has it. */
+#if defined(__GNUC__) && !defined(__clang__)
+#define QUICKHULL_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define QUICKHULL_NO_FP_CONTRACT
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define QUICKHULL_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "../corecvs/core/math/vector/vector3d.h"
+#include "../corecvs/core/geometry/polygons.h"
+
+typedef std::vector<corecvs::Vector3dd> vertices;
+
+typedef struct {
+    corecvs::Triangle3dd plane;
+    vertices points;
+} tFace;
+
+inline bool operator ==(const corecvs::Triangle3dd &a, const corecvs::Triangle3dd &b) {
+    std::vector<corecvs::Vector3dd> plane1 = { b.p1(), b.p2(), b.p3() };
+    auto findX = std::find(plane1.begin(), plane1.end(), a.p1());
+    auto findY = std::find(plane1.begin(), plane1.end(), a.p2());
+    auto findZ = std::find(plane1.begin(), plane1.end(), a.p3());
+    return (findX != plane1.end()) && (findY != plane1.end()) && (findZ != plane1.end());
+}
+inline bool operator !=(const corecvs::Triangle3dd &a, const corecvs::Triangle3dd &b) {
+    return !(a == b);
+}
+
+inline bool operator ==(const tFace &a, const tFace &b)
+{
+    return a.plane == b.plane;
+}
+
+typedef std::vector<tFace> tFaces;
+
+inline corecvs::Vector3dd createVect(const corecvs::Vector3dd &p1, const corecvs::Vector3dd &p2) {
+    return { p2.x() - p1.x(), p2.y() - p1.y(), p2.z() - p1.z() };
+}
+
+inline double vectMod (const corecvs::Vector3dd &vect) {
+    return sqrt(vect.x() * vect.x() + vect.y() * vect.y() + vect.z() * vect.z());
+}
+
+inline double scalarProd(const corecvs::Vector3dd &v1, const corecvs::Vector3dd &v2) {
+    return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z();
+}
+
+inline corecvs::Vector3dd vectProd(const corecvs::Vector3dd &v1, const corecvs::Vector3dd &v2){
+    return  { v1.y() * v2.z() - v1.z() * v2.y(), v1.z() * v2.x() - v1.x() * v2.z(), v1.x() * v2.y() - v1.y() * v2.x() };
+}
+
+inline double tripleProd(const corecvs::Vector3dd &v1, const corecvs::Vector3dd &v2, const corecvs::Vector3dd &v3) {
+    return scalarProd(v1, vectProd(v2, v3));
+}
+
+inline double pointDist(const corecvs::Vector3dd &p1, const corecvs::Vector3dd &p2) {
+    return vectMod(createVect(p1, p2));
+}
+
+inline double pointLineDist(const corecvs::Vector3dd &lineP1, const corecvs::Vector3dd &lineP2, const corecvs::Vector3dd &point) {
+    corecvs::Vector3dd lineVect = createVect(lineP1, lineP2);
+    return vectMod(vectProd(lineVect, createVect(lineP1, point))) / vectMod(lineVect);
+}
+
+inline double pointPlaneDist(const corecvs::Vector3dd &planeP1, const corecvs::Vector3dd &planeP2, const corecvs::Vector3dd &planeP3, const corecvs::Vector3dd &point) {
+    corecvs::Vector3dd baseV1 = createVect(planeP1, planeP2);
+    corecvs::Vector3dd baseV2 = createVect(planeP1, planeP3);
+    return tripleProd(baseV1, baseV2, createVect(planeP1, point)) / vectMod(vectProd(baseV1, baseV2));
+}
+
+/* Points stored as separate coordinate arrays. The hull itself works on doubles; float clouds only go through the
+   culling pass, which keeps every point it cannot reject with a margin. */
+template <typename tCoord>
+struct tPointCloudOf {
+    std::vector<tCoord> x, y, z;
+};
+
+typedef tPointCloudOf<double> tPointCloud;
+
+typedef std::vector<uint32_t> tPointIds;
+
+/* Refills cloud with the vertices, reusing its capacity. */
+inline void fillPointCloud(const vertices &listVertices, tPointCloud &cloud) {
+    cloud.x.resize(listVertices.size());
+    cloud.y.resize(listVertices.size());
+    cloud.z.resize(listVertices.size());
+    for (size_t i = 0; i < listVertices.size(); i++) {
+        cloud.x[i] = listVertices[i].x();
+        cloud.y[i] = listVertices[i].y();
+        cloud.z[i] = listVertices[i].z();
+    }
+}
+
+inline tPointCloud makePointCloud(const vertices &listVertices) {
+    tPointCloud cloud;
+    fillPointCloud(listVertices, cloud);
+    return cloud;
+}
+
+inline corecvs::Vector3dd cloudPoint(const tPointCloud &cloud, uint32_t i) {
+    return { cloud.x[i], cloud.y[i], cloud.z[i] };
+}
+
+inline bool samePoint(const tPointCloud &cloud, uint32_t i, uint32_t j) {
+    return cloud.x[i] == cloud.x[j] && cloud.y[i] == cloud.y[j] && cloud.z[i] == cloud.z[j];
+}
+
+/* Adds b to the nonoverlapping expansion e[0, length), dropping zero components (Shewchuk's Grow-Expansion). The
+   expansion grows by at most one component. */
+inline void growExpansion(double *e, size_t &length, double b) {
+    double q = b;
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++) {
+        double sum = q + e[i];
+        double bVirtual = sum - q;
+        double aVirtual = sum - bVirtual;
+        double error = (q - aVirtual) + (e[i] - bVirtual);
+        q = sum;
+        if (error != 0)
+            e[n++] = error;
+    }
+    length = n;
+    if (q != 0)
+        e[length++] = q;
+}
+
+/* Every product of three coordinates is split into four exact terms, so the sum never has more components. */
+const size_t orient3dTerms = 24 * 4;
+
+/* Sign of the 4x4 determinant with rows (p[i], 1), summed exactly from the 24 products of three coordinates. */
+inline int orient3dExact(const double p[4][3]) {
+    double sum[orient3dTerms];
+    size_t length = 0;
+    std::array<int, 4> perm = {0, 1, 2, 3};
+    do {
+        int inversions = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = i + 1; j < 4; j++)
+                if (perm[i] > perm[j])
+                    inversions++;
+        double factors[3];
+        int count = 0;
+        for (int i = 0; i < 4; i++)
+            if (perm[i] != 3)
+                factors[count++] = p[i][perm[i]];
+        double product = factors[0] * factors[1];
+        double low = fma(factors[0], factors[1], -product);
+        double terms[4] = {product * factors[2], fma(product, factors[2], -product * factors[2]),
+                           low * factors[2], fma(low, factors[2], -low * factors[2])};
+        for (auto term : terms)
+            growExpansion(sum, length, inversions % 2 ? -term : term);
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    return length == 0 ? 0 : (sum[length - 1] > 0 ? 1 : -1);
+}
+
+/* Sign of (d - a) . ((b - a) x (c - a)): positive when d lies on the side the normal of abc points to. The double
+   evaluation is trusted when it clears Shewchuk's static error bound, so only near-coplanar points pay for the exact
+   sum. */
+inline int orient3d(const tPointCloud &cloud, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    double adx = cloud.x[a] - cloud.x[d], ady = cloud.y[a] - cloud.y[d], adz = cloud.z[a] - cloud.z[d];
+    double bdx = cloud.x[b] - cloud.x[d], bdy = cloud.y[b] - cloud.y[d], bdz = cloud.z[b] - cloud.z[d];
+    double cdx = cloud.x[c] - cloud.x[d], cdy = cloud.y[c] - cloud.y[d], cdz = cloud.z[c] - cloud.z[d];
+    double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady, adxcdy = adx * cdy;
+    double adxbdy = adx * bdy, bdxady = bdx * ady;
+    double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+    double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) + (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) +
+                       (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+    const double unit = std::numeric_limits<double>::epsilon() / 2;
+    const double errorBound = (7 + 56 * unit) * unit;
+    if (det > errorBound * permanent)
+        return -1;
+    if (-det > errorBound * permanent)
+        return 1;
+    const double p[4][3] = {{cloud.x[a], cloud.y[a], cloud.z[a]}, {cloud.x[b], cloud.y[b], cloud.z[b]},
+                            {cloud.x[c], cloud.y[c], cloud.z[c]}, {cloud.x[d], cloud.y[d], cloud.z[d]}};
+    return -orient3dExact(p);
+}
+
+/* Counters and per-phase timers of one hull build, copied to options.stats when it is set. The engine only fills
+   them when built with QUICKHULL_STATS; otherwise the instrumentation compiles away and the struct stays zero.
+   The partition phase includes the culling pass; horizon, cone and redistribution are summed over the expansion
+   steps, and over the workers with concurrent expansion. */
+struct tHullStats {
+    uint64_t iterations;
+    uint64_t visibilityTests;
+    uint64_t facesCreated;
+    uint64_t facesDeleted;
+    uint64_t pointsReassigned;
+    uint64_t maxConflictList;
+    uint64_t duplicatesRemoved;
+    uint64_t simplexNs;
+    uint64_t partitionNs;
+    uint64_t horizonNs;
+    uint64_t coneNs;
+    uint64_t redistributeNs;
+
+    tHullStats() : iterations(0), visibilityTests(0), facesCreated(0), facesDeleted(0), pointsReassigned(0),
+                   maxConflictList(0), duplicatesRemoved(0), simplexNs(0), partitionNs(0), horizonNs(0), coneNs(0), redistributeNs(0) {}
+};
+
+#ifdef QUICKHULL_STATS
+/* HULL_STAT(code) keeps code only in instrumented builds. */
+#define HULL_STAT(...) __VA_ARGS__
+#else
+#define HULL_STAT(...)
+#endif
+
+/* Splits a stretch of code into phases: every lap adds the time since the previous one to its counter. */
+struct tPhaseClock {
+    std::chrono::steady_clock::time_point last;
+
+    tPhaseClock() : last(std::chrono::steady_clock::now()) {}
+
+    void lap(uint64_t &phaseNs) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        phaseNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+    }
+};
+
+inline void addHullStats(tHullStats &total, const tHullStats &part) {
+    total.iterations += part.iterations;
+    total.visibilityTests += part.visibilityTests;
+    total.facesCreated += part.facesCreated;
+    total.facesDeleted += part.facesDeleted;
+    total.pointsReassigned += part.pointsReassigned;
+    total.maxConflictList = std::max(total.maxConflictList, part.maxConflictList);
+    total.duplicatesRemoved += part.duplicatesRemoved;
+    total.simplexNs += part.simplexNs;
+    total.partitionNs += part.partitionNs;
+    total.horizonNs += part.horizonNs;
+    total.coneNs += part.coneNs;
+    total.redistributeNs += part.redistributeNs;
+}
+
+struct tQuickHullOptions {
+    unsigned threads;
+    bool cullInterior;
+    bool concurrentExpansion;
+    bool furthestFirst;
+    bool spatialOrder;
+    bool removeDuplicates;
+    double duplicateTolerance;
+    /* When set, duplicate removal reports the number of points it dropped and, for every point of the cloud, the
+       id kept in its place. Points dropped by culling map to themselves. */
+    size_t *duplicatesRemoved;
+    tPointIds *duplicateSurvivors;
+    tHullStats *stats;
+
+    tQuickHullOptions() : threads(0), cullInterior(false), concurrentExpansion(false), furthestFirst(false),
+                          spatialOrder(false), removeDuplicates(false), duplicateTolerance(0),
+                          duplicatesRemoved(nullptr), duplicateSurvivors(nullptr), stats(nullptr) {}
+};
+
+const size_t minPointsPerWorker = 1 << 16;
+
+inline unsigned hullWorkers(const tQuickHullOptions &options, size_t count) {
+    unsigned workers = options.threads ? options.threads : std::thread::hardware_concurrency();
+    size_t maxWorkers = count / minPointsPerWorker;
+    if (workers > maxWorkers)
+        workers = (unsigned)maxWorkers;
+    return workers ? workers : 1;
+}
+
+/* Runs body(worker, begin, end) over [0, count) split into equal contiguous chunks, one per worker. */
+template<typename Body>
+void parallelFor(unsigned workers, size_t count, const Body &body) {
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; w++)
+        threads.emplace_back([&body, w, workers, count]() { body(w, count * w / workers, count * (w + 1) / workers); });
+    body(0, 0, count / workers);
+    for (auto &worker : threads)
+        worker.join();
+}
+
+typedef std::array<uint32_t, 6> tExtremePoints;
+
+inline void scanExtremePoints(const tPointCloud &cloud, uint32_t begin, uint32_t end, tExtremePoints &EP) {
+    for (uint32_t i = begin; i < end; i++) {
+        if (cloud.x[i] <= cloud.x[EP[0]]) EP[0] = i;
+        if (cloud.x[i] >= cloud.x[EP[1]]) EP[1] = i;
+        if (cloud.y[i] <= cloud.y[EP[2]]) EP[2] = i;
+        if (cloud.y[i] >= cloud.y[EP[3]]) EP[3] = i;
+        if (cloud.z[i] <= cloud.z[EP[4]]) EP[4] = i;
+        if (cloud.z[i] >= cloud.z[EP[5]]) EP[5] = i;
+    }
+}
+
+inline tExtremePoints findExtremePoints(const tPointCloud &cloud, unsigned workers = 1) {
+    tExtremePoints EP = {{0, 0, 0, 0, 0, 0}};
+    if (workers == 1) {
+        scanExtremePoints(cloud, 0, (uint32_t)cloud.x.size(), EP);
+        return EP;
+    }
+    std::vector<tExtremePoints> workerEP(workers);
+    parallelFor(workers, cloud.x.size(), [&](unsigned w, size_t begin, size_t end) {
+        workerEP[w].fill((uint32_t)begin);
+        scanExtremePoints(cloud, (uint32_t)begin, (uint32_t)end, workerEP[w]);
+    });
+    for (auto &local : workerEP)
+        for (int k = 0; k < 6; k++) {
+            const std::vector<double> &axis = k < 2 ? cloud.x : (k < 4 ? cloud.y : cloud.z);
+            if (k % 2 == 0 ? axis[local[k]] <= axis[EP[k]] : axis[local[k]] >= axis[EP[k]])
+                EP[k] = local[k];
+        }
+    return EP;
+}
+
+/* The point with the largest distance(i) over the whole cloud, or first when no distance is positive. */
+template <typename tDistance>
+uint32_t furthestCloudPoint(const tPointCloud &cloud, unsigned workers, uint32_t first, const tDistance &distance) {
+    auto scan = [&](size_t begin, size_t end) {
+        std::pair<double, uint32_t> local = {0, first};
+        for (uint32_t i = (uint32_t)begin; i < end; i++) {
+            double dist = distance(i);
+            if (dist > local.first)
+                local = {dist, i};
+        }
+        return local;
+    };
+    if (workers == 1)
+        return scan(0, cloud.x.size()).second;
+    std::vector<std::pair<double, uint32_t>> workerBest(workers);
+    parallelFor(workers, cloud.x.size(), [&](unsigned w, size_t begin, size_t end) {
+        workerBest[w] = scan(begin, end);
+    });
+    std::pair<double, uint32_t> best = {0, first};
+    for (auto &local : workerBest)
+        if (local.first > best.first)
+            best = local;
+    return best.second;
+}
+
+/* The base triangle comes from the extreme points, unless they lie within epsilon of a line: the extremes of a
+   full-dimensional cloud can all sit on one diagonal, so then the third corner is the point furthest from that line
+   among all points. The apex is always the point furthest from the base plane. */
+inline std::array<uint32_t, 4> createSimplex(const tPointCloud &cloud, const tExtremePoints &EP, double epsilon, unsigned workers = 1) {
+    double maxDist = 0;
+    uint32_t triangleP1 = EP[0], triangleP2 = EP[0], triangleP3 = EP[0];
+    for (auto point1 : EP)
+        for (auto point2 : EP) {
+            double dist = pointDist(cloudPoint(cloud, point1), cloudPoint(cloud, point2));
+            if (dist > maxDist) {
+                maxDist = dist;
+                triangleP1 = point1;
+                triangleP2 = point2;
+            }
+        }
+
+    maxDist = 0;
+    corecvs::Vector3dd base = cloudPoint(cloud, triangleP1);
+    for (auto point : EP) {
+        double dist = pointLineDist(base, cloudPoint(cloud, triangleP2), cloudPoint(cloud, point));
+        if (dist > maxDist) {
+            maxDist = dist;
+            triangleP3 = point;
+        }
+    }
+    if (maxDist <= std::max(epsilon, 0.0) && triangleP1 != triangleP2) {
+        corecvs::Vector3dd direction = createVect(base, cloudPoint(cloud, triangleP2));
+        triangleP3 = furthestCloudPoint(cloud, workers, triangleP3, [&](uint32_t i) {
+            return vectMod(vectProd(direction, {cloud.x[i] - base.x(), cloud.y[i] - base.y(), cloud.z[i] - base.z()}));
+        });
+    }
+
+    corecvs::Vector3dd normal = vectProd(createVect(base, cloudPoint(cloud, triangleP2)), createVect(base, cloudPoint(cloud, triangleP3)));
+    double offset = scalarProd(normal, base);
+    uint32_t apex = furthestCloudPoint(cloud, workers, EP[0], [&](uint32_t i) {
+        return std::abs(normal.x() * cloud.x[i] + normal.y() * cloud.y[i] + normal.z() * cloud.z[i] - offset);
+    });
+    std::array<uint32_t, 4> Res;
+    if (scalarProd(normal, cloudPoint(cloud, apex)) - offset > 0)
+         Res = {{ triangleP1, triangleP3, triangleP2, apex }};
+    else Res = {{ triangleP1, triangleP2, triangleP3, apex }};
+    return Res;
+};
+
+typedef struct {
+    uint32_t vertex[3];
+    corecvs::Vector3dd normal;
+    double offset;
+    tPointIds points;
+    uint32_t furthest;
+    double furthestDist;
+    int adjacent[3];
+    unsigned visited;
+    uint32_t generation;
+    bool visible;
+    bool deleted;
+} tMeshFace;
+
+typedef std::pair<int, int> tHorizonEdge;
+
+/* Slot of the horizon vertex table: the first horizon edge starting at vertex and how many do. */
+typedef struct {
+    uint32_t vertex;
+    int edge;
+    int count;
+} tHorizonStart;
+
+typedef struct {
+    int id;
+    uint32_t generation;
+} tFaceHandle;
+
+typedef struct {
+    double dist;
+    tFaceHandle handle;
+} tScheduledFace;
+
+inline bool operator <(const tScheduledFace &a, const tScheduledFace &b) {
+    return a.dist < b.dist;
+}
+
+/* Working storage of one expansion. It lives as long as the mesh, so repeated builds reuse its capacity. */
+typedef struct {
+    std::vector<int> simplexFaces;
+    std::vector<int> visibleFaces;
+    std::vector<tHorizonEdge> horizon;
+    std::vector<tHorizonEdge> horizonLoop;
+    std::vector<tHorizonStart> horizonStarts;
+    std::vector<int> horizonLoops;
+    std::vector<int> newFaces;
+    tPointIds unclaimedPoints;
+    std::vector<tFaceHandle> faceQueue;
+    std::vector<tScheduledFace> faceHeap;
+#ifdef QUICKHULL_STATS
+    tHullStats stats;
+#endif
+} tHullScratch;
+
+typedef struct {
+    std::vector<tMeshFace> faces;
+    std::vector<int> freeFaces;
+    tHullScratch scratch;
+    unsigned iteration;
+} tHullMesh;
+
+inline double pointFaceDist(const tMeshFace &face, const tPointCloud &cloud, uint32_t point) {
+    return face.normal.x() * cloud.x[point] + face.normal.y() * cloud.y[point] + face.normal.z() * cloud.z[point] - face.offset;
+}
+
+inline bool faceIsVisible(const tPointCloud &cloud, uint32_t eyePoint, const tMeshFace &face) {
+    return orient3d(cloud, face.vertex[0], face.vertex[1], face.vertex[2], eyePoint) > 0;
+}
+
+/* Conflict lists are built from rounded distances, so with a zero tolerance the furthest point can lie on the face
+   itself. Keeps only the points that see the face and returns whether any are left. */
+inline bool settleFurthestPoint(const tPointCloud &cloud, tMeshFace &face) {
+    if (faceIsVisible(cloud, face.furthest, face))
+        return true;
+    size_t kept = 0;
+    face.furthestDist = -HUGE_VAL;
+    for (auto point : face.points)
+        if (faceIsVisible(cloud, point, face)) {
+            double dist = pointFaceDist(face, cloud, point);
+            if (dist > face.furthestDist) {
+                face.furthestDist = dist;
+                face.furthest = point;
+            }
+            face.points[kept++] = point;
+        }
+    face.points.resize(kept);
+    return kept != 0;
+}
+
+inline void initMeshFace(tMeshFace &face, const tPointCloud &cloud, uint32_t p1, uint32_t p2, uint32_t p3) {
+    face.vertex[0] = p1;
+    face.vertex[1] = p2;
+    face.vertex[2] = p3;
+    corecvs::Vector3dd base = cloudPoint(cloud, p1);
+    corecvs::Vector3dd normal = vectProd(createVect(base, cloudPoint(cloud, p2)), createVect(base, cloudPoint(cloud, p3)));
+    double normalMod = vectMod(normal);
+    if (normalMod > 0)
+        face.normal = {normal.x() / normalMod, normal.y() / normalMod, normal.z() / normalMod};
+    else
+        face.normal = {0, 0, 0};
+    face.offset = scalarProd(face.normal, base);
+    face.furthest = p1;
+    face.furthestDist = -HUGE_VAL;
+    face.adjacent[0] = face.adjacent[1] = face.adjacent[2] = -1;
+    face.visited = 0;
+    face.visible = false;
+    face.deleted = false;
+}
+
+inline int addMeshFace(tHullMesh &mesh, const tPointCloud &cloud, uint32_t p1, uint32_t p2, uint32_t p3) {
+    int id;
+    if (!mesh.freeFaces.empty()) {
+        id = mesh.freeFaces.back();
+        mesh.freeFaces.pop_back();
+    } else {
+        id = (int)mesh.faces.size();
+        mesh.faces.push_back(tMeshFace());
+        mesh.faces[id].generation = 0;
+        // Every slot may come back to the free list, so it grows with the pool rather than during a later build.
+        mesh.freeFaces.reserve(mesh.faces.capacity());
+    }
+    initMeshFace(mesh.faces[id], cloud, p1, p2, p3);
+    HULL_STAT(mesh.scratch.stats.facesCreated++);
+    return id;
+}
+
+inline void releaseMeshFace(tHullMesh &mesh, int id) {
+    tMeshFace &face = mesh.faces[id];
+    face.points.clear();
+    face.deleted = true;
+    face.generation++;
+    mesh.freeFaces.push_back(id);
+    HULL_STAT(mesh.scratch.stats.facesDeleted++);
+}
+
+/* Empties the mesh but keeps every face slot and its conflict list allocated for the next build. */
+inline void resetHullMesh(tHullMesh &mesh) {
+    mesh.freeFaces.clear();
+    for (size_t id = mesh.faces.size(); id-- > 0;) {
+        tMeshFace &face = mesh.faces[id];
+        if (!face.deleted) {
+            face.points.clear();
+            face.deleted = true;
+            face.generation++;
+        }
+        mesh.freeFaces.push_back((int)id);
+    }
+}
+
+inline tFaceHandle faceHandle(const tHullMesh &mesh, int id) {
+    return { id, mesh.faces[id].generation };
+}
+
+inline bool handleIsAlive(const tHullMesh &mesh, const tFaceHandle &handle) {
+    return mesh.faces[handle.id].generation == handle.generation;
+}
+
+/* Stitches the faces to each other along their shared edges. Only the simplex is linked this way, so a quadratic
+   search costs less than any table. */
+inline void linkMeshFaces(tHullMesh &mesh, const std::vector<int> &faceIds) {
+    for (auto id : faceIds)
+        for (int i = 0; i < 3; i++) {
+            tMeshFace &face = mesh.faces[id];
+            uint32_t from = face.vertex[i], to = face.vertex[(i + 1) % 3];
+            for (auto twinId : faceIds)
+                for (int j = 0; j < 3; j++) {
+                    const tMeshFace &twin = mesh.faces[twinId];
+                    if (twin.vertex[j] == to && twin.vertex[(j + 1) % 3] == from)
+                        face.adjacent[i] = twinId;
+                }
+        }
+}
+
+/* Links the cone faces scratch.newFaces[k] = (from, to, eye) built on horizon edge k to each other. The horizon is
+   left in loop order by repairVisibleRegion, so the next cone face is simply the next one. */
+inline void linkConeFaces(tHullMesh &mesh, const tHullScratch &scratch) {
+    const std::vector<int> &cone = scratch.newFaces;
+    for (size_t k = 0; k < cone.size(); k++) {
+        int next = cone[k + 1 < cone.size() ? k + 1 : 0];
+        mesh.faces[cone[k]].adjacent[1] = next;
+        mesh.faces[next].adjacent[2] = cone[k];
+    }
+}
+
+/* Open addressing over a power-of-two table: the slot holding vertex, or the empty slot where it belongs. */
+inline size_t horizonSlot(const std::vector<tHorizonStart> &starts, uint32_t vertex) {
+    size_t mask = starts.size() - 1;
+    uint64_t hash = vertex * 0x9e3779b97f4a7c15ull;
+    size_t slot = (size_t)(hash ^ (hash >> 32)) & mask;
+    while (starts[slot].edge != -1 && starts[slot].vertex != vertex)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+inline void collectHorizon(const tHullMesh &mesh, tHullScratch &scratch) {
+    scratch.horizon.clear();
+    for (auto id : scratch.visibleFaces)
+        for (int i = 0; i < 3; i++)
+            if (!mesh.faces[mesh.faces[id].adjacent[i]].visible)
+                scratch.horizon.push_back({id, i});
+}
+
+/* Rounding on near-coplanar faces can leave the visible region touching itself at a horizon vertex or enclosing
+   hidden faces, and stitching a cone to such a horizon would tear the mesh. Around every such vertex all hidden runs
+   of faces but the one lying deepest below eyePoint join the region, as do the ring faces of every boundary loop but
+   the longest; returns how many faces were added, and when none were leaves the horizon ordered along its loop.
+   touch(id) is called before a face off the ring is read and may refuse it, in which case -1 is returned. */
+template <typename tTouch>
+int repairVisibleRegion(tHullMesh &mesh, const tPointCloud &cloud, uint32_t eyePoint, tHullScratch &scratch, tTouch touch) {
+    std::vector<tHorizonEdge> &horizon = scratch.horizon;
+    std::vector<tHorizonStart> &starts = scratch.horizonStarts;
+    std::vector<int> &fan = scratch.horizonLoops;
+    size_t regionSize = scratch.visibleFaces.size();
+    size_t tableSize = 4;
+    while (tableSize < 2 * horizon.size())
+        tableSize *= 2;
+    starts.assign(tableSize, {0, -1, 0});
+    for (size_t k = 0; k < horizon.size(); k++) {
+        uint32_t vertex = mesh.faces[horizon[k].first].vertex[horizon[k].second];
+        tHorizonStart &start = starts[horizonSlot(starts, vertex)];
+        if (start.edge == -1)
+            start = {vertex, (int)k, 0};
+        start.count++;
+    }
+    for (auto &start : starts) {
+        if (start.count < 2)
+            continue;
+        uint32_t vertex = start.vertex;
+        int first = horizon[start.edge].first;
+        fan.clear();
+        for (int id = first;;) {
+            const tMeshFace &face = mesh.faces[id];
+            id = face.adjacent[face.vertex[0] == vertex ? 0 : face.vertex[1] == vertex ? 1 : 2];
+            if (id == first)
+                break;
+            if (!touch(id))
+                return -1;
+            fan.push_back(id);
+        }
+        size_t deepestBegin = 0, deepestEnd = 0;
+        double deepest = HUGE_VAL;
+        for (size_t begin = 0; begin < fan.size();) {
+            if (mesh.faces[fan[begin]].visible) {
+                begin++;
+                continue;
+            }
+            size_t end = begin;
+            double depth = HUGE_VAL;
+            for (; end < fan.size() && !mesh.faces[fan[end]].visible; end++)
+                depth = std::min(depth, pointFaceDist(mesh.faces[fan[end]], cloud, eyePoint));
+            if (depth < deepest) {
+                deepest = depth;
+                deepestBegin = begin;
+                deepestEnd = end;
+            }
+            begin = end;
+        }
+        for (size_t i = 0; i < fan.size(); i++)
+            if ((i < deepestBegin || i >= deepestEnd) && !mesh.faces[fan[i]].visible) {
+                mesh.faces[fan[i]].visible = true;
+                scratch.visibleFaces.push_back(fan[i]);
+            }
+    }
+    if (scratch.visibleFaces.size() > regionSize)
+        return (int)(scratch.visibleFaces.size() - regionSize);
+
+    std::vector<int> &loops = fan;
+    loops.assign(horizon.size(), -1);
+    scratch.horizonLoop.clear();
+    int loopCount = 0, longest = 0;
+    size_t longestSize = 0;
+    for (size_t k = 0; k < horizon.size(); k++) {
+        if (loops[k] != -1)
+            continue;
+        size_t size = 0;
+        for (int edge = (int)k; edge != -1 && loops[edge] == -1; size++) {
+            loops[edge] = loopCount;
+            if (loopCount == 0)
+                scratch.horizonLoop.push_back(horizon[edge]);
+            const tMeshFace &face = mesh.faces[horizon[edge].first];
+            edge = starts[horizonSlot(starts, face.vertex[(horizon[edge].second + 1) % 3])].edge;
+        }
+        if (size > longestSize) {
+            longestSize = size;
+            longest = loopCount;
+        }
+        loopCount++;
+    }
+    if (loopCount == 1) {
+        horizon.swap(scratch.horizonLoop);
+        return 0;
+    }
+    for (size_t k = 0; k < horizon.size(); k++)
+        if (loops[k] != longest) {
+            int id = mesh.faces[horizon[k].first].adjacent[horizon[k].second];
+            if (!mesh.faces[id].visible) {
+                mesh.faces[id].visible = true;
+                scratch.visibleFaces.push_back(id);
+            }
+        }
+    return (int)(scratch.visibleFaces.size() - regionSize);
+}
+
+/* Flood-fills mesh.scratch.visibleFaces with the faces seen from eyePoint, starting at start, and leaves the edges
+   between the region and the rest of the mesh in mesh.scratch.horizon. The tolerance only decides which points are
+   worth adding; every face the point lies above is replaced, so no cone face can fold back over a hidden one. */
+inline void findVisibleRegion(tHullMesh &mesh, const tPointCloud &cloud, int start, uint32_t eyePoint) {
+    tHullScratch &scratch = mesh.scratch;
+    unsigned stamp = ++mesh.iteration;
+    mesh.faces[start].visited = stamp;
+    mesh.faces[start].visible = true;
+    scratch.visibleFaces.assign(1, start);
+    auto touch = [&mesh, stamp](int id) {
+        if (mesh.faces[id].visited != stamp) {
+            mesh.faces[id].visited = stamp;
+            mesh.faces[id].visible = false;
+        }
+        return true;
+    };
+    size_t k = 0;
+    do {
+        for (; k < scratch.visibleFaces.size(); k++) {
+            int id = scratch.visibleFaces[k];
+            for (int i = 0; i < 3; i++) {
+                tMeshFace &neighbour = mesh.faces[mesh.faces[id].adjacent[i]];
+                if (neighbour.visited != stamp) {
+                    neighbour.visited = stamp;
+                    neighbour.visible = faceIsVisible(cloud, eyePoint, neighbour);
+                    HULL_STAT(scratch.stats.visibilityTests++);
+                    if (neighbour.visible)
+                        scratch.visibleFaces.push_back(mesh.faces[id].adjacent[i]);
+                }
+            }
+        }
+        collectHorizon(mesh, scratch);
+    } while (repairVisibleRegion(mesh, cloud, eyePoint, scratch, touch) > 0);
+}
+
+typedef size_t (*tPartitionKernel)(const tPointCloud &cloud, tMeshFace &face, double eps, uint32_t *points, size_t count);
+
+/* Kernels move every point of points[0, count) that sees the face into face.points, keep face.furthest up to date
+   and compact the remaining points to the front of the array, returning their number. */
+QUICKHULL_NO_FP_CONTRACT
+inline size_t partitionPointsScalar(const tPointCloud &cloud, tMeshFace &face, double eps, uint32_t *points, size_t count) {
+    size_t rest = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t point = points[i];
+        double dist = pointFaceDist(face, cloud, point);
+        if (dist > eps && !samePoint(cloud, point, face.vertex[0])
+                && !samePoint(cloud, point, face.vertex[1]) && !samePoint(cloud, point, face.vertex[2])) {
+            face.points.push_back(point);
+            if (dist > face.furthestDist) {
+                face.furthestDist = dist;
+                face.furthest = point;
+            }
+        } else
+            points[rest++] = point;
+    }
+    return rest;
+}
+
+/* A tolerance of zero or less asks for the exact hull, so the conflict test is the orientation predicate itself. */
+QUICKHULL_NO_FP_CONTRACT
+inline size_t partitionPointsExact(const tPointCloud &cloud, tMeshFace &face, double, uint32_t *points, size_t count) {
+    size_t rest = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t point = points[i];
+        if (faceIsVisible(cloud, point, face)) {
+            double dist = pointFaceDist(face, cloud, point);
+            face.points.push_back(point);
+            if (dist > face.furthestDist) {
+                face.furthestDist = dist;
+                face.furthest = point;
+            }
+        } else
+            points[rest++] = point;
+    }
+    return rest;
+}
+
+inline void mergeFurthestLanes(tMeshFace &face, const double *dist, const double *pos, const double *id, int lanes) {
+    double bestPos = -1;
+    for (int k = 0; k < lanes; k++)
+        if (dist[k] > face.furthestDist || (dist[k] == face.furthestDist && pos[k] < bestPos)) {
+            face.furthestDist = dist[k];
+            face.furthest = (uint32_t)id[k];
+            bestPos = pos[k];
+        }
+}
+
+#ifdef QUICKHULL_X86_SIMD
+
+__attribute__((target("avx2"))) QUICKHULL_NO_FP_CONTRACT
+inline size_t partitionPointsAvx2(const tPointCloud &cloud, tMeshFace &face, double eps, uint32_t *points, size_t count) {
+    const __m256d nx = _mm256_set1_pd(face.normal.x()), ny = _mm256_set1_pd(face.normal.y()), nz = _mm256_set1_pd(face.normal.z());
+    const __m256d offset = _mm256_set1_pd(face.offset), epsV = _mm256_set1_pd(eps), four = _mm256_set1_pd(4);
+    __m256d vx[3], vy[3], vz[3];
+    for (int v = 0; v < 3; v++) {
+        vx[v] = _mm256_set1_pd(cloud.x[face.vertex[v]]);
+        vy[v] = _mm256_set1_pd(cloud.y[face.vertex[v]]);
+        vz[v] = _mm256_set1_pd(cloud.z[face.vertex[v]]);
+    }
+    __m256d bestDist = _mm256_set1_pd(-HUGE_VAL), bestPos = _mm256_set1_pd(-1), bestId = _mm256_setzero_pd();
+    __m256d pos = _mm256_set_pd(3, 2, 1, 0);
+    const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    size_t rest = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t ids[4] = {points[i], points[i + 1], points[i + 2], points[i + 3]};
+        __m128i idx = _mm_loadu_si128((const __m128i *)ids);
+        __m256d x = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), cloud.x.data(), idx, allLanes, 8);
+        __m256d y = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), cloud.y.data(), idx, allLanes, 8);
+        __m256d z = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), cloud.z.data(), idx, allLanes, 8);
+        __m256d dist = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, x), _mm256_mul_pd(ny, y)), _mm256_mul_pd(nz, z)), offset);
+        __m256d visible = _mm256_cmp_pd(dist, epsV, _CMP_GT_OQ);
+        for (int v = 0; v < 3; v++) {
+            __m256d same = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(x, vx[v], _CMP_EQ_OQ), _mm256_cmp_pd(y, vy[v], _CMP_EQ_OQ)),
+                                         _mm256_cmp_pd(z, vz[v], _CMP_EQ_OQ));
+            visible = _mm256_andnot_pd(same, visible);
+        }
+        __m256d better = _mm256_and_pd(visible, _mm256_cmp_pd(dist, bestDist, _CMP_GT_OQ));
+        bestDist = _mm256_blendv_pd(bestDist, dist, better);
+        bestPos = _mm256_blendv_pd(bestPos, pos, better);
+        bestId = _mm256_blendv_pd(bestId, _mm256_cvtepi32_pd(idx), better);
+        pos = _mm256_add_pd(pos, four);
+
+        int mask = _mm256_movemask_pd(visible);
+        for (int k = 0; k < 4; k++)
+            if (mask & (1 << k))
+                face.points.push_back(ids[k]);
+            else
+                points[rest++] = ids[k];
+    }
+    double laneDist[4], lanePos[4], laneId[4];
+    _mm256_storeu_pd(laneDist, bestDist);
+    _mm256_storeu_pd(lanePos, bestPos);
+    _mm256_storeu_pd(laneId, bestId);
+    mergeFurthestLanes(face, laneDist, lanePos, laneId, 4);
+    size_t tail = partitionPointsScalar(cloud, face, eps, points + i, count - i);
+    for (size_t k = 0; k < tail; k++)
+        points[rest++] = points[i + k];
+    return rest;
+}
+
+__attribute__((target("avx512f"))) QUICKHULL_NO_FP_CONTRACT
+inline size_t partitionPointsAvx512(const tPointCloud &cloud, tMeshFace &face, double eps, uint32_t *points, size_t count) {
+    const __m512d nx = _mm512_set1_pd(face.normal.x()), ny = _mm512_set1_pd(face.normal.y()), nz = _mm512_set1_pd(face.normal.z());
+    const __m512d offset = _mm512_set1_pd(face.offset), epsV = _mm512_set1_pd(eps), eight = _mm512_set1_pd(8);
+    __m512d vx[3], vy[3], vz[3];
+    for (int v = 0; v < 3; v++) {
+        vx[v] = _mm512_set1_pd(cloud.x[face.vertex[v]]);
+        vy[v] = _mm512_set1_pd(cloud.y[face.vertex[v]]);
+        vz[v] = _mm512_set1_pd(cloud.z[face.vertex[v]]);
+    }
+    __m512d bestDist = _mm512_set1_pd(-HUGE_VAL), bestPos = _mm512_set1_pd(-1), bestId = _mm512_setzero_pd();
+    __m512d pos = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+    size_t rest = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32_t ids[8];
+        for (int k = 0; k < 8; k++)
+            ids[k] = points[i + k];
+        __m256i idx = _mm256_loadu_si256((const __m256i *)ids);
+        __m512d x = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, idx, cloud.x.data(), 8);
+        __m512d y = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, idx, cloud.y.data(), 8);
+        __m512d z = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, idx, cloud.z.data(), 8);
+        __m512d dist = _mm512_sub_pd(_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(nx, x), _mm512_mul_pd(ny, y)), _mm512_mul_pd(nz, z)), offset);
+        __mmask8 visible = _mm512_cmp_pd_mask(dist, epsV, _CMP_GT_OQ);
+        for (int v = 0; v < 3; v++) {
+            __mmask8 same = _mm512_cmp_pd_mask(x, vx[v], _CMP_EQ_OQ) & _mm512_cmp_pd_mask(y, vy[v], _CMP_EQ_OQ)
+                            & _mm512_cmp_pd_mask(z, vz[v], _CMP_EQ_OQ);
+            visible &= ~same;
+        }
+        __mmask8 better = visible & _mm512_cmp_pd_mask(dist, bestDist, _CMP_GT_OQ);
+        bestDist = _mm512_mask_blend_pd(better, bestDist, dist);
+        bestPos = _mm512_mask_blend_pd(better, bestPos, pos);
+        bestId = _mm512_mask_blend_pd(better, bestId, _mm512_maskz_cvtepi32_pd(0xff, idx));
+        pos = _mm512_add_pd(pos, eight);
+
+        for (int k = 0; k < 8; k++)
+            if (visible & (1 << k))
+                face.points.push_back(ids[k]);
+            else
+                points[rest++] = ids[k];
+    }
+    double laneDist[8], lanePos[8], laneId[8];
+    _mm512_storeu_pd(laneDist, bestDist);
+    _mm512_storeu_pd(lanePos, bestPos);
+    _mm512_storeu_pd(laneId, bestId);
+    mergeFurthestLanes(face, laneDist, lanePos, laneId, 8);
+    size_t tail = partitionPointsScalar(cloud, face, eps, points + i, count - i);
+    for (size_t k = 0; k < tail; k++)
+        points[rest++] = points[i + k];
+    return rest;
+}
+#endif
+
+inline tPartitionKernel selectPartitionKernel() {
+#ifdef QUICKHULL_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return partitionPointsAvx512;
+    if (__builtin_cpu_supports("avx2"))
+        return partitionPointsAvx2;
+#endif
+    return partitionPointsScalar;
+}
+
+/* Gathers take signed 32-bit offsets, so the SIMD kernels only serve clouds of fewer than 2^31 points. */
+const size_t maxGatherPoints = (size_t)1 << 31;
+
+inline tPartitionKernel partitionKernel(const tPointCloud &cloud, double eps) {
+    static const tPartitionKernel simdKernel = selectPartitionKernel();
+    if (eps <= 0)
+        return partitionPointsExact;
+    return cloud.x.size() < maxGatherPoints ? simdKernel : partitionPointsScalar;
+}
+
+/* Returns the number of point-face tests made. */
+inline size_t addPointsToFaces(tHullMesh &mesh, const std::vector<int> &faceIds, const tPointCloud &cloud, tPointIds &points, double eps) {
+    size_t count = points.size(), tests = 0;
+    tPartitionKernel kernel = partitionKernel(cloud, eps);
+    for (auto id : faceIds) {
+        if (count == 0)
+            break;
+        tests += count;
+        count = kernel(cloud, mesh.faces[id], eps, points.data(), count);
+    }
+    points.clear();
+    return tests;
+}
+
+/* Akl-Toussaint pre-pass. The extreme points of the cloud along 13 axes (26 directions: faces, edges and corners
+   of a cube) span a small polytope inside the hull; points strictly inside it can never be hull vertices. */
+const int cullingAxes = 13;
+const double cullingAxis[cullingAxes][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}, {1, -1, 0}, {1, 0, 1}, {1, 0, -1},
+                                            {0, 1, 1}, {0, 1, -1}, {1, 1, 1}, {1, 1, -1}, {1, -1, 1}, {1, -1, -1}};
+
+typedef std::array<uint32_t, 2 * cullingAxes> tCullingExtremes;
+
+template <typename tCoord>
+struct tCullingPolytopeOf {
+    std::vector<tCoord> nx, ny, nz, offset;
+};
+
+typedef tCullingPolytopeOf<double> tCullingPolytope;
+
+template <typename tCoord>
+void scanCullingExtremes(const tPointCloudOf<tCoord> &cloud, size_t begin, size_t end, tCullingExtremes &extremes, double *extent) {
+    for (size_t i = begin; i < end; i++)
+        for (int k = 0; k < cullingAxes; k++) {
+            double proj = cullingAxis[k][0] * cloud.x[i] + cullingAxis[k][1] * cloud.y[i] + cullingAxis[k][2] * cloud.z[i];
+            if (proj < extent[2 * k]) {
+                extent[2 * k] = proj;
+                extremes[2 * k] = (uint32_t)i;
+            }
+            if (proj > extent[2 * k + 1]) {
+                extent[2 * k + 1] = proj;
+                extremes[2 * k + 1] = (uint32_t)i;
+            }
+        }
+}
+
+inline tFaces quickHull(const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options);
+
+inline void resetCullingExtent(double *extent) {
+    for (int k = 0; k < cullingAxes; k++) {
+        extent[2 * k] = HUGE_VAL;
+        extent[2 * k + 1] = -HUGE_VAL;
+    }
+}
+
+/* The polytope spanned by the given points, which must lie inside the hull. The planes are rounded to tCoord and
+   every offset is lowered by a bound on the error of evaluating the plane in tCoord, so a point the cull rejects lies
+   inside the exact polytope even when the evaluation is done in float. */
+template <typename tCoord>
+bool buildCullingPolytope(const tPointCloudOf<tCoord> &cloud, tPointIds extremes, double eps, tCullingPolytopeOf<tCoord> &polytope) {
+    std::sort(extremes.begin(), extremes.end());
+    extremes.erase(std::unique(extremes.begin(), extremes.end()), extremes.end());
+    tPointCloud corners;
+    double scale = 0;
+    for (auto point : extremes) {
+        corners.x.push_back(cloud.x[point]);
+        corners.y.push_back(cloud.y[point]);
+        corners.z.push_back(cloud.z[point]);
+        scale = std::max(scale, std::max(fabs((double)cloud.x[point]), std::max(fabs((double)cloud.y[point]), fabs((double)cloud.z[point]))));
+    }
+    tQuickHullOptions cornerOptions;
+    cornerOptions.threads = 1;
+    tFaces faces = quickHull(corners, eps, cornerOptions);
+    if (faces.empty())
+        return false;
+    for (auto &face : faces) {
+        corecvs::Vector3dd normal = vectProd(createVect(face.plane.p1(), face.plane.p2()), createVect(face.plane.p1(), face.plane.p3()));
+        double normalMod = vectMod(normal);
+        if (normalMod == 0)
+            continue;
+        double offset = scalarProd(normal, face.plane.p1()) / normalMod;
+        double error = 4 * std::numeric_limits<tCoord>::epsilon() * (2 * scale + fabs(offset));
+        polytope.nx.push_back((tCoord)(normal.x() / normalMod));
+        polytope.ny.push_back((tCoord)(normal.y() / normalMod));
+        polytope.nz.push_back((tCoord)(normal.z() / normalMod));
+        polytope.offset.push_back((tCoord)(offset - error));
+    }
+    return true;
+}
+
+const size_t cullingBlock = 64;
+
+/* Works plane by plane over fixed-size blocks of points so that the inner loop runs over contiguous coordinates. The
+   block is copied out first so that the loop has a constant trip count and vectorises, twice as wide for floats. */
+template <typename tCoord>
+void cullSlice(const tPointCloudOf<tCoord> &cloud, const tCullingPolytopeOf<tCoord> &polytope, double eps, size_t begin, size_t end, tPointIds &survivors) {
+    size_t planes = polytope.offset.size();
+    tCoord outside[cullingBlock], x[cullingBlock], y[cullingBlock], z[cullingBlock];
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += cullingBlock) {
+        size_t blockSize = std::min(cullingBlock, end - blockBegin);
+        for (size_t j = 0; j < cullingBlock; j++) {
+            size_t i = blockBegin + std::min(j, blockSize - 1);
+            x[j] = cloud.x[i];
+            y[j] = cloud.y[i];
+            z[j] = cloud.z[i];
+            outside[j] = -std::numeric_limits<tCoord>::infinity();
+        }
+        for (size_t k = 0; k < planes; k++) {
+            tCoord nx = polytope.nx[k], ny = polytope.ny[k], nz = polytope.nz[k], offset = polytope.offset[k];
+            for (size_t j = 0; j < cullingBlock; j++)
+                outside[j] = std::max(outside[j], nx * x[j] + ny * y[j] + nz * z[j] - offset);
+        }
+        for (size_t j = 0; j < blockSize; j++)
+            if (outside[j] >= -eps)
+                survivors.push_back((uint32_t)(blockBegin + j));
+    }
+}
+
+/* Ids of the points in [first, last) outside the polytope, in increasing order. */
+template <typename tCoord>
+tPointIds cullRange(const tPointCloudOf<tCoord> &cloud, const tCullingPolytopeOf<tCoord> &polytope, double eps, unsigned workers, size_t first, size_t last) {
+    std::vector<tPointIds> workerSurvivors(workers);
+    parallelFor(workers, last - first, [&](unsigned w, size_t begin, size_t end) {
+        cullSlice(cloud, polytope, eps, first + begin, first + end, workerSurvivors[w]);
+    });
+    if (workers == 1)
+        return std::move(workerSurvivors[0]);
+    tPointIds survivors;
+    size_t total = 0;
+    for (auto &local : workerSurvivors)
+        total += local.size();
+    survivors.reserve(total);
+    for (auto &local : workerSurvivors)
+        survivors.insert(survivors.end(), local.begin(), local.end());
+    return survivors;
+}
+
+/* Ids of the points that survive the culling pass, in increasing order. */
+template <typename tCoord>
+tPointIds cullInteriorPoints(const tPointCloudOf<tCoord> &cloud, double eps, unsigned workers = 1) {
+    std::vector<tCullingExtremes> workerExtremes(workers);
+    std::vector<std::array<double, 2 * cullingAxes>> workerExtent(workers);
+    parallelFor(workers, cloud.x.size(), [&](unsigned w, size_t begin, size_t end) {
+        workerExtremes[w].fill((uint32_t)begin);
+        resetCullingExtent(workerExtent[w].data());
+        scanCullingExtremes(cloud, begin, end, workerExtremes[w], workerExtent[w].data());
+    });
+
+    tPointIds extremes;
+    for (auto &local : workerExtremes)
+        extremes.insert(extremes.end(), local.begin(), local.end());
+    tCullingPolytopeOf<tCoord> polytope;
+    if (!buildCullingPolytope(cloud, extremes, eps, polytope)) {
+        tPointIds survivors(cloud.x.size());
+        for (uint32_t i = 0; i < survivors.size(); i++)
+            survivors[i] = i;
+        return survivors;
+    }
+    return cullRange(cloud, polytope, eps, workers, 0, cloud.x.size());
+}
+
+/* Splits the candidate points between the simplex faces. Every worker partitions its own slice into private copies
+   of the faces; the buckets are then concatenated in slice order, which gives the same lists as a single pass. */
+inline void partitionCloud(tHullMesh &mesh, const std::vector<int> &faceIds, const tPointCloud &cloud, tPointIds &points, double eps, unsigned workers) {
+    if (workers == 1) {
+        HULL_STAT(mesh.scratch.stats.visibilityTests +=) addPointsToFaces(mesh, faceIds, cloud, points, eps);
+        return;
+    }
+
+    std::vector<std::vector<tMeshFace>> buckets(workers);
+    std::vector<size_t> tests(workers, 0);
+    parallelFor(workers, points.size(), [&](unsigned w, size_t begin, size_t end) {
+        size_t count = end - begin;
+        for (auto id : faceIds) {
+            buckets[w].push_back(mesh.faces[id]);
+            tests[w] += count;
+            if (count != 0)
+                count = partitionKernel(cloud, eps)(cloud, buckets[w].back(), eps, points.data() + begin, count);
+        }
+    });
+    HULL_STAT(for (auto count : tests) mesh.scratch.stats.visibilityTests += count);
+    for (size_t k = 0; k < faceIds.size(); k++) {
+        tMeshFace &face = mesh.faces[faceIds[k]];
+        size_t total = 0;
+        for (auto &bucket : buckets)
+            total += bucket[k].points.size();
+        face.points.reserve(total);
+        for (auto &bucket : buckets) {
+            tMeshFace &local = bucket[k];
+            face.points.insert(face.points.end(), local.points.begin(), local.points.end());
+            if (local.furthestDist > face.furthestDist) {
+                face.furthestDist = local.furthestDist;
+                face.furthest = local.furthest;
+            }
+            tPointIds().swap(local.points);
+        }
+    }
+    tPointIds().swap(points);
+}
+
+/* Replaces the region visible from the furthest conflict point of faceId by a cone of new faces, which are left in
+   mesh.scratch.newFaces with the freed conflict points redistributed over them. */
+inline void expandFace(tHullMesh &mesh, const tPointCloud &cloud, int faceId, double epsilon) {
+    tHullScratch &scratch = mesh.scratch;
+    uint32_t furthest = mesh.faces[faceId].furthest;
+    HULL_STAT(tPhaseClock clock);
+    HULL_STAT(scratch.stats.iterations++);
+
+    findVisibleRegion(mesh, cloud, faceId, furthest);
+    HULL_STAT(clock.lap(scratch.stats.horizonNs));
+
+    scratch.newFaces.clear();
+    for (auto &edge : scratch.horizon) {
+        const tMeshFace &face = mesh.faces[edge.first];
+        int newId = addMeshFace(mesh, cloud, face.vertex[edge.second], face.vertex[(edge.second + 1) % 3], furthest);
+        int neighbourId = mesh.faces[edge.first].adjacent[edge.second];
+        tMeshFace &neighbour = mesh.faces[neighbourId];
+        for (int i = 0; i < 3; i++)
+            if (neighbour.adjacent[i] == edge.first) {
+                neighbour.adjacent[i] = newId;
+                break;
+            }
+        mesh.faces[newId].adjacent[0] = neighbourId;
+        scratch.newFaces.push_back(newId);
+    }
+    linkConeFaces(mesh, scratch);
+    HULL_STAT(clock.lap(scratch.stats.coneNs));
+
+    scratch.unclaimedPoints.clear();
+    for (auto id : scratch.visibleFaces) {
+        tMeshFace &face = mesh.faces[id];
+        scratch.unclaimedPoints.insert(scratch.unclaimedPoints.end(), face.points.begin(), face.points.end());
+        releaseMeshFace(mesh, id);
+    }
+
+    HULL_STAT(scratch.stats.pointsReassigned += scratch.unclaimedPoints.size());
+    HULL_STAT(scratch.stats.visibilityTests +=) addPointsToFaces(mesh, scratch.newFaces, cloud, scratch.unclaimedPoints, epsilon);
+    HULL_STAT(clock.lap(scratch.stats.redistributeNs));
+}
+
+/* Concurrent expansion. Workers take conflict faces from their own deque and steal from the others when it runs
+   dry. Before touching a face a worker claims it with a CAS on claims[id]; a step claims the visible region and the
+   ring of faces around it, so expansions running at the same time never share a face or an edge. When a claim fails
+   the worker waits only for owners with a higher number and otherwise backs off and retries the face later, so no
+   cycle of waits can form. The face array only grows while every worker is parked between steps. */
+const uint32_t unclaimedFace = 0;
+const uint32_t freeFace = 0xffffffff;
+
+typedef struct {
+    uint32_t from, to;
+    int neighbour, neighbourSlot;
+} tConeEdge;
+
+typedef struct {
+    std::mutex lock;
+    std::deque<tFaceHandle> handles;
+} tWorkQueue;
+
+typedef struct {
+    tHullMesh *mesh;
+    const tPointCloud *cloud;
+    double eps;
+    unsigned workers;
+    std::unique_ptr<std::atomic<uint32_t>[]> claims;
+    size_t capacity, used;
+    std::vector<int> freeFaces;
+    std::mutex freeLock;
+    std::unique_ptr<tWorkQueue[]> queues;
+    std::atomic<size_t> pending;
+    std::mutex gateLock;
+    std::condition_variable gate;
+    unsigned running;
+    std::atomic<bool> growRequested;
+    bool growing;
+} tConcurrentHull;
+
+typedef struct {
+    tHullScratch scratch;
+    std::vector<int> claimed;
+    std::vector<tConeEdge> cone;
+    std::vector<int> extraFaces;
+} tWorkerScratch;
+
+enum tStepResult { stepDone, stepStale, stepRetry, stepGrow };
+
+inline void resizeFacePool(tConcurrentHull &hull, size_t capacity) {
+    tHullMesh &mesh = *hull.mesh;
+    size_t oldSize = mesh.faces.size();
+    mesh.faces.resize(capacity);
+    for (size_t id = oldSize; id < capacity; id++) {
+        mesh.faces[id].deleted = true;
+        mesh.faces[id].generation = 0;
+    }
+    std::unique_ptr<std::atomic<uint32_t>[]> claims(new std::atomic<uint32_t>[capacity]);
+    for (size_t id = 0; id < capacity; id++)
+        claims[id].store(id < hull.capacity ? hull.claims[id].load() : (uint32_t)freeFace);
+    hull.claims = std::move(claims);
+    hull.capacity = capacity;
+}
+
+/* Parks the calling worker between steps while the face array grows; with grow set the worker is the one asking. */
+inline void parkWorker(tConcurrentHull &hull, bool grow) {
+    std::unique_lock<std::mutex> lock(hull.gateLock);
+    hull.running--;
+    if (grow)
+        hull.growRequested = true;
+    hull.gate.notify_all();
+    if (grow && !hull.growing) {
+        hull.growing = true;
+        hull.gate.wait(lock, [&hull]() { return hull.running == 0; });
+        resizeFacePool(hull, hull.capacity * 2);
+        hull.growing = false;
+        hull.growRequested = false;
+        hull.gate.notify_all();
+    } else
+        hull.gate.wait(lock, [&hull]() { return !hull.growRequested; });
+    hull.running++;
+}
+
+/* Claims a face for worker, waiting while it is held by a worker with a higher number. */
+inline bool claimFace(tConcurrentHull &hull, int id, uint32_t worker) {
+    for (;;) {
+        uint32_t owner = unclaimedFace;
+        if (hull.claims[id].compare_exchange_strong(owner, worker, std::memory_order_acquire))
+            return true;
+        if (owner == worker)
+            return true;
+        if (owner == freeFace || owner < worker)
+            return false;
+        std::this_thread::yield();
+    }
+}
+
+inline void releaseClaims(tConcurrentHull &hull, const std::vector<int> &faceIds) {
+    for (auto id : faceIds)
+        hull.claims[id].store(unclaimedFace, std::memory_order_release);
+}
+
+inline int allocateFace(tConcurrentHull &hull) {
+    std::lock_guard<std::mutex> lock(hull.freeLock);
+    if (!hull.freeFaces.empty()) {
+        int id = hull.freeFaces.back();
+        hull.freeFaces.pop_back();
+        return id;
+    }
+    if (hull.used < hull.capacity)
+        return (int)hull.used++;
+    return -1;
+}
+
+inline void freeFaces(tConcurrentHull &hull, const std::vector<int> &faceIds) {
+    std::lock_guard<std::mutex> lock(hull.freeLock);
+    hull.freeFaces.insert(hull.freeFaces.end(), faceIds.begin(), faceIds.end());
+}
+
+inline tStepResult expandFaceConcurrently(tConcurrentHull &hull, tWorkerScratch &local, const tFaceHandle &handle, uint32_t worker) {
+    tHullMesh &mesh = *hull.mesh;
+    const tPointCloud &cloud = *hull.cloud;
+    tHullScratch &scratch = local.scratch;
+    local.claimed.clear();
+    uint32_t owner = unclaimedFace;
+    if (!hull.claims[handle.id].compare_exchange_strong(owner, worker, std::memory_order_acquire))
+        return owner == freeFace ? stepStale : stepRetry;
+    local.claimed.push_back(handle.id);
+    if (!handleIsAlive(mesh, handle) || mesh.faces[handle.id].points.empty() ||
+        !settleFurthestPoint(cloud, mesh.faces[handle.id])) {
+        releaseClaims(hull, local.claimed);
+        return stepStale;
+    }
+    HULL_STAT(tPhaseClock clock);
+    HULL_STAT(uint64_t conflictList = mesh.faces[handle.id].points.size());
+
+    uint32_t furthest = mesh.faces[handle.id].furthest;
+    scratch.visibleFaces.assign(1, handle.id);
+    mesh.faces[handle.id].visible = true;
+    auto touch = [&hull, &local, &mesh, worker](int id) {
+        if (hull.claims[id].load(std::memory_order_acquire) == worker)
+            return true;
+        if (!claimFace(hull, id, worker))
+            return false;
+        local.claimed.push_back(id);
+        mesh.faces[id].visible = false;
+        return true;
+    };
+    size_t k = 0;
+    int repaired;
+    do {
+        for (; k < scratch.visibleFaces.size(); k++) {
+            int id = scratch.visibleFaces[k];
+            for (int i = 0; i < 3; i++) {
+                int neighbourId = mesh.faces[id].adjacent[i];
+                if (hull.claims[neighbourId].load(std::memory_order_acquire) != worker) {
+                    if (!claimFace(hull, neighbourId, worker)) {
+                        releaseClaims(hull, local.claimed);
+                        return stepRetry;
+                    }
+                    local.claimed.push_back(neighbourId);
+                    tMeshFace &neighbour = mesh.faces[neighbourId];
+                    neighbour.visible = faceIsVisible(cloud, furthest, neighbour);
+                    HULL_STAT(scratch.stats.visibilityTests++);
+                    if (neighbour.visible)
+                        scratch.visibleFaces.push_back(neighbourId);
+                }
+            }
+        }
+        collectHorizon(mesh, scratch);
+        repaired = repairVisibleRegion(mesh, cloud, furthest, scratch, touch);
+        if (repaired < 0) {
+            releaseClaims(hull, local.claimed);
+            return stepRetry;
+        }
+    } while (repaired > 0);
+
+    local.extraFaces.clear();
+    for (size_t k = scratch.visibleFaces.size(); k < scratch.horizon.size(); k++) {
+        int id = allocateFace(hull);
+        if (id == -1) {
+            freeFaces(hull, local.extraFaces);
+            releaseClaims(hull, local.claimed);
+            return stepGrow;
+        }
+        local.extraFaces.push_back(id);
+    }
+    HULL_STAT(clock.lap(scratch.stats.horizonNs));
+
+    local.cone.clear();
+    for (auto &edge : scratch.horizon) {
+        const tMeshFace &face = mesh.faces[edge.first];
+        tConeEdge cone = {face.vertex[edge.second], face.vertex[(edge.second + 1) % 3], face.adjacent[edge.second], 0};
+        const tMeshFace &neighbour = mesh.faces[cone.neighbour];
+        for (int i = 0; i < 3; i++)
+            if (neighbour.vertex[i] == cone.to && neighbour.vertex[(i + 1) % 3] == cone.from)
+                cone.neighbourSlot = i;
+        local.cone.push_back(cone);
+    }
+    scratch.unclaimedPoints.clear();
+    for (auto id : scratch.visibleFaces) {
+        tMeshFace &face = mesh.faces[id];
+        scratch.unclaimedPoints.insert(scratch.unclaimedPoints.end(), face.points.begin(), face.points.end());
+        face.points.clear();
+        face.generation++;
+    }
+
+    scratch.newFaces.clear();
+    for (size_t k = 0; k < local.cone.size(); k++) {
+        const tConeEdge &cone = local.cone[k];
+        int id = k < scratch.visibleFaces.size() ? scratch.visibleFaces[k] : local.extraFaces[k - scratch.visibleFaces.size()];
+        hull.claims[id].store(worker, std::memory_order_relaxed);
+        initMeshFace(mesh.faces[id], cloud, cone.from, cone.to, furthest);
+        mesh.faces[id].adjacent[0] = cone.neighbour;
+        mesh.faces[cone.neighbour].adjacent[cone.neighbourSlot] = id;
+        scratch.newFaces.push_back(id);
+    }
+    linkConeFaces(mesh, scratch);
+    HULL_STAT(clock.lap(scratch.stats.coneNs));
+    HULL_STAT(scratch.stats.pointsReassigned += scratch.unclaimedPoints.size());
+    HULL_STAT(scratch.stats.visibilityTests +=) addPointsToFaces(mesh, scratch.newFaces, cloud, scratch.unclaimedPoints, hull.eps);
+
+    size_t pushed = 0;
+    {
+        tWorkQueue &queue = hull.queues[worker - 1];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        for (auto id : scratch.newFaces)
+            if (!mesh.faces[id].points.empty()) {
+                queue.handles.push_back(faceHandle(mesh, id));
+                pushed++;
+            }
+    }
+    hull.pending += pushed;
+
+    local.extraFaces.clear();
+    for (size_t k = local.cone.size(); k < scratch.visibleFaces.size(); k++) {
+        int id = scratch.visibleFaces[k];
+        mesh.faces[id].deleted = true;
+        hull.claims[id].store(freeFace, std::memory_order_release);
+        local.extraFaces.push_back(id);
+    }
+    freeFaces(hull, local.extraFaces);
+    for (auto id : scratch.newFaces)
+        hull.claims[id].store(unclaimedFace, std::memory_order_release);
+    for (auto id : local.claimed)
+        if (hull.claims[id].load(std::memory_order_relaxed) == worker)
+            hull.claims[id].store(unclaimedFace, std::memory_order_release);
+    HULL_STAT(clock.lap(scratch.stats.redistributeNs));
+    HULL_STAT(scratch.stats.iterations++);
+    HULL_STAT(scratch.stats.facesCreated += local.cone.size());
+    HULL_STAT(scratch.stats.facesDeleted += scratch.visibleFaces.size());
+    HULL_STAT(scratch.stats.maxConflictList = std::max(scratch.stats.maxConflictList, conflictList));
+    return stepDone;
+}
+
+inline bool takeWork(tConcurrentHull &hull, unsigned w, tFaceHandle &handle) {
+    {
+        tWorkQueue &own = hull.queues[w];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.handles.empty()) {
+            handle = own.handles.back();
+            own.handles.pop_back();
+            return true;
+        }
+    }
+    for (unsigned k = 1; k < hull.workers; k++) {
+        tWorkQueue &victim = hull.queues[(w + k) % hull.workers];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.handles.empty()) {
+            handle = victim.handles.front();
+            victim.handles.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void runExpansionWorker(tConcurrentHull &hull, unsigned w) {
+    tWorkerScratch local;
+    uint32_t worker = w + 1;
+    tFaceHandle handle;
+    while (hull.pending.load() != 0) {
+        if (hull.growRequested.load())
+            parkWorker(hull, false);
+        if (!takeWork(hull, w, handle)) {
+            std::this_thread::yield();
+            continue;
+        }
+        tStepResult result = expandFaceConcurrently(hull, local, handle, worker);
+        if (result == stepRetry || result == stepGrow) {
+            tWorkQueue &own = hull.queues[w];
+            {
+                std::lock_guard<std::mutex> lock(own.lock);
+                own.handles.push_front(handle);
+            }
+            if (result == stepGrow)
+                parkWorker(hull, true);
+            else
+                std::this_thread::yield();
+        } else
+            hull.pending--;
+    }
+    std::lock_guard<std::mutex> lock(hull.gateLock);
+    HULL_STAT(addHullStats(hull.mesh->scratch.stats, local.scratch.stats));
+    hull.running--;
+    hull.gate.notify_all();
+}
+
+inline void expandConcurrently(tHullMesh &mesh, const tPointCloud &cloud, double eps, unsigned workers, const std::vector<int> &startFaces) {
+    tConcurrentHull hull;
+    hull.mesh = &mesh;
+    hull.cloud = &cloud;
+    hull.eps = eps;
+    hull.workers = workers;
+    hull.capacity = 0;
+    hull.used = mesh.faces.size();
+    resizeFacePool(hull, std::max<size_t>(hull.used * 4, 4096));
+    for (size_t id = 0; id < hull.used; id++)
+        if (mesh.faces[id].deleted)
+            hull.freeFaces.push_back((int)id);
+        else
+            hull.claims[id].store(unclaimedFace);
+    hull.queues.reset(new tWorkQueue[workers]);
+    hull.pending = 0;
+    for (size_t k = 0; k < startFaces.size(); k++)
+        if (!mesh.faces[startFaces[k]].points.empty()) {
+            hull.queues[k % workers].handles.push_back(faceHandle(mesh, startFaces[k]));
+            hull.pending++;
+        }
+    hull.running = workers;
+    hull.growRequested = false;
+    hull.growing = false;
+
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; w++)
+        threads.emplace_back(runExpansionWorker, std::ref(hull), w);
+    runExpansionWorker(hull, 0);
+    for (auto &worker : threads)
+        worker.join();
+
+    mesh.faces.resize(hull.used);
+    mesh.freeFaces.clear();
+    mesh.freeFaces.reserve(mesh.faces.size());
+    for (size_t id = 0; id < mesh.faces.size(); id++)
+        if (mesh.faces[id].deleted)
+            mesh.freeFaces.push_back((int)id);
+}
+
+/* Furthest-first order: always expands the face whose furthest conflict point lies furthest out, so the points
+   added early are the ones most likely to stay on the hull and fewer cone faces are built only to be swallowed.
+   Stops early once no conflict point lies more than a positive tolerance above its face, or once the hull has
+   maxVertices vertices (0 for no limit), and returns the largest distance left; zero means the hull is complete. */
+inline double expandFurthestFirst(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const std::vector<int> &startFaces,
+                           double tolerance = 0, size_t maxVertices = 0) {
+    std::vector<tScheduledFace> &heap = mesh.scratch.faceHeap;
+    heap.clear();
+    for (auto id : startFaces)
+        if (!mesh.faces[id].points.empty()) {
+            heap.push_back({mesh.faces[id].furthestDist, faceHandle(mesh, id)});
+            push_heap(heap.begin(), heap.end());
+        }
+
+    size_t vertexCount = 4;
+    while (!heap.empty()) {
+        tScheduledFace top = heap.front();
+        if (!handleIsAlive(mesh, top.handle) || mesh.faces[top.handle.id].points.empty()) {
+            pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+            continue;
+        }
+        if ((tolerance > 0 && top.dist <= tolerance) || (maxVertices && vertexCount >= maxVertices))
+            return top.dist;
+        pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+        if (!settleFurthestPoint(cloud, mesh.faces[top.handle.id]))
+            continue;
+        HULL_STAT(mesh.scratch.stats.maxConflictList = std::max<uint64_t>(mesh.scratch.stats.maxConflictList, mesh.faces[top.handle.id].points.size()));
+        expandFace(mesh, cloud, top.handle.id, epsilon);
+        /* The visible region is a disk of F faces bounded by H horizon edges, so it had (F - H + 2) / 2 inner
+           vertices, all of which leave the hull as the eye point joins it. */
+        vertexCount = vertexCount + 1 - (mesh.scratch.visibleFaces.size() + 2 - mesh.scratch.newFaces.size()) / 2;
+        for (auto id : mesh.scratch.newFaces)
+            if (!mesh.faces[id].points.empty()) {
+                heap.push_back({mesh.faces[id].furthestDist, faceHandle(mesh, id)});
+                push_heap(heap.begin(), heap.end());
+            }
+    }
+    return 0;
+}
+
+/* Expands every face in startFaces that has conflict points until no face has any left. */
+inline void expandHull(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, unsigned workers, const tQuickHullOptions &options, const std::vector<int> &startFaces) {
+    if (options.concurrentExpansion && workers > 1) {
+        expandConcurrently(mesh, cloud, epsilon, workers, startFaces);
+        return;
+    }
+    if (options.furthestFirst) {
+        expandFurthestFirst(mesh, cloud, epsilon, startFaces);
+        return;
+    }
+    std::vector<tFaceHandle> &Queue = mesh.scratch.faceQueue;
+    Queue.clear();
+    for (auto id : startFaces)
+        if (!mesh.faces[id].points.empty()) Queue.push_back(faceHandle(mesh, id));
+
+    for (size_t next = 0; next < Queue.size(); next++) {
+        tFaceHandle handle = Queue[next];
+        if (!handleIsAlive(mesh, handle) || mesh.faces[handle.id].points.empty() ||
+            !settleFurthestPoint(cloud, mesh.faces[handle.id]))
+            continue;
+        HULL_STAT(mesh.scratch.stats.maxConflictList = std::max<uint64_t>(mesh.scratch.stats.maxConflictList, mesh.faces[handle.id].points.size()));
+        expandFace(mesh, cloud, handle.id, epsilon);
+        for (auto id : mesh.scratch.newFaces)
+            if (!mesh.faces[id].points.empty()) Queue.push_back(faceHandle(mesh, id));
+    }
+}
+
+/* Number of dimensions the simplex spans. Points closer than epsilon count as one, and a point within epsilon of the
+   line or plane through the others adds no dimension; a tolerance of zero or less compares exactly. */
+inline int simplexDimension(const tPointCloud &cloud, const std::array<uint32_t, 4> &simplex, double epsilon) {
+    corecvs::Vector3dd p0 = cloudPoint(cloud, simplex[0]), p1 = cloudPoint(cloud, simplex[1]), p2 = cloudPoint(cloud, simplex[2]);
+    if (pointDist(p0, p2) > pointDist(p0, p1))
+        std::swap(p1, p2);
+    double tolerance = std::max(epsilon, 0.0);
+    if (pointDist(p0, p1) <= tolerance)
+        return 0;
+    if (pointLineDist(p0, p1, p2) <= tolerance)
+        return 1;
+    if (epsilon > 0 ? fabs(pointPlaneDist(p0, p1, p2, cloudPoint(cloud, simplex[3]))) <= epsilon
+                    : orient3d(cloud, simplex[0], simplex[1], simplex[2], simplex[3]) == 0)
+        return 2;
+    return 3;
+}
+
+/* Puts the simplex into the mesh and splits the candidate points between its faces, which are returned. */
+inline const std::vector<int> &startHullOnSimplex(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options, unsigned workers, const std::array<uint32_t, 4> &simplex) {
+    mesh.iteration = 0;
+    std::vector<int> &simplexFaces = mesh.scratch.simplexFaces;
+    simplexFaces.clear();
+    simplexFaces.push_back(addMeshFace(mesh, cloud, simplex[0], simplex[1], simplex[2]));
+    simplexFaces.push_back(addMeshFace(mesh, cloud, simplex[0], simplex[2], simplex[3]));
+    simplexFaces.push_back(addMeshFace(mesh, cloud, simplex[1], simplex[3], simplex[2]));
+    simplexFaces.push_back(addMeshFace(mesh, cloud, simplex[0], simplex[3], simplex[1]));
+    linkMeshFaces(mesh, simplexFaces);
+    HULL_STAT(tPhaseClock clock);
+    tPointIds &candidates = mesh.scratch.unclaimedPoints;
+    if (options.cullInterior)
+        candidates = cullInteriorPoints(cloud, epsilon, workers);
+    else {
+        candidates.resize(cloud.x.size());
+        for (uint32_t i = 0; i < candidates.size(); i++)
+            candidates[i] = i;
+    }
+    partitionCloud(mesh, simplexFaces, cloud, candidates, epsilon, hullWorkers(options, candidates.size()));
+    HULL_STAT(clock.lap(mesh.scratch.stats.partitionNs));
+    return simplexFaces;
+}
+
+inline void buildHullOnSimplex(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options, unsigned workers, const std::array<uint32_t, 4> &simplex) {
+    const std::vector<int> &simplexFaces = startHullOnSimplex(mesh, cloud, epsilon, options, workers, simplex);
+    expandHull(mesh, cloud, epsilon, options.threads ? options.threads : workers, options, simplexFaces);
+}
+
+template <typename tCoord>
+tPointCloud selectPoints(const tPointCloudOf<tCoord> &cloud, const tPointIds &ids, unsigned workers = 1) {
+    tPointCloud selected;
+    selected.x.resize(ids.size());
+    selected.y.resize(ids.size());
+    selected.z.resize(ids.size());
+    parallelFor(workers, ids.size(), [&](unsigned, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            selected.x[i] = cloud.x[ids[i]];
+            selected.y[i] = cloud.y[ids[i]];
+            selected.z[i] = cloud.z[ids[i]];
+        }
+    });
+    return selected;
+}
+
+/* Optional pre-pass: with the points stored in Morton order, spatial neighbours are neighbours in memory, so conflict
+   lists and redistribution walk coherent memory instead of the caller's order. Codes interleave 10 bits per axis of
+   the position in the bounding box. */
+const int mortonBits = 10;
+const int radixBits = 10;
+
+inline uint32_t spreadMortonBits(uint32_t v) {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+/* Sorts ids by the Morton code of their points with a stable LSD radix sort; every pass counts and scatters the same
+   contiguous slices in parallel, with the bucket offsets laid out digit by digit and worker by worker. */
+inline void sortByMortonCode(const tPointCloud &cloud, tPointIds &ids, unsigned workers) {
+    size_t count = ids.size();
+    std::vector<std::array<double, 6>> boxes(workers);
+    parallelFor(workers, count, [&](unsigned w, size_t begin, size_t end) {
+        std::array<double, 6> &box = boxes[w];
+        box = {{HUGE_VAL, HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL}};
+        for (size_t i = begin; i < end; i++) {
+            double point[3] = {cloud.x[ids[i]], cloud.y[ids[i]], cloud.z[ids[i]]};
+            for (int k = 0; k < 3; k++) {
+                box[k] = std::min(box[k], point[k]);
+                box[k + 3] = std::max(box[k + 3], point[k]);
+            }
+        }
+    });
+    double low[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL}, scale[3];
+    for (int k = 0; k < 3; k++) {
+        double high = -HUGE_VAL;
+        for (auto &box : boxes) {
+            low[k] = std::min(low[k], box[k]);
+            high = std::max(high, box[k + 3]);
+        }
+        scale[k] = high > low[k] ? ((1 << mortonBits) - 1) / (high - low[k]) : 0;
+    }
+
+    const uint32_t maxCell = (1 << mortonBits) - 1;
+    std::vector<uint32_t> keys(count), sortedKeys(count);
+    tPointIds sortedIds(count);
+    parallelFor(workers, count, [&](unsigned, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t cell[3] = {std::min(maxCell, (uint32_t)((cloud.x[ids[i]] - low[0]) * scale[0])),
+                                std::min(maxCell, (uint32_t)((cloud.y[ids[i]] - low[1]) * scale[1])),
+                                std::min(maxCell, (uint32_t)((cloud.z[ids[i]] - low[2]) * scale[2]))};
+            keys[i] = spreadMortonBits(cell[0]) | spreadMortonBits(cell[1]) << 1 | spreadMortonBits(cell[2]) << 2;
+        }
+    });
+    const size_t buckets = 1 << radixBits;
+    std::vector<size_t> offsets(workers * buckets);
+    for (int shift = 0; shift < 3 * mortonBits; shift += radixBits) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        parallelFor(workers, count, [&](unsigned w, size_t begin, size_t end) {
+            size_t *local = &offsets[w * buckets];
+            for (size_t i = begin; i < end; i++)
+                local[(keys[i] >> shift) & (buckets - 1)]++;
+        });
+        size_t position = 0;
+        for (size_t digit = 0; digit < buckets; digit++)
+            for (unsigned w = 0; w < workers; w++) {
+                size_t size = offsets[w * buckets + digit];
+                offsets[w * buckets + digit] = position;
+                position += size;
+            }
+        parallelFor(workers, count, [&](unsigned w, size_t begin, size_t end) {
+            size_t *local = &offsets[w * buckets];
+            for (size_t i = begin; i < end; i++) {
+                size_t &slot = local[(keys[i] >> shift) & (buckets - 1)];
+                sortedKeys[slot] = keys[i];
+                sortedIds[slot] = ids[i];
+                slot++;
+            }
+        });
+        keys.swap(sortedKeys);
+        ids.swap(sortedIds);
+    }
+}
+
+/* Duplicate removal: points are equal when their coordinates are, or with a tolerance when they fall in the same
+   cell of a grid of that side, so two points closer than the tolerance across a cell border both stay. */
+inline double duplicateCell(double coord, double inverseTolerance) {
+    return inverseTolerance > 0 ? floor(coord * inverseTolerance) : coord + 0.0;
+}
+
+inline bool sameDuplicateCell(const tPointCloud &cloud, uint32_t i, uint32_t j, double inverseTolerance) {
+    return duplicateCell(cloud.x[i], inverseTolerance) == duplicateCell(cloud.x[j], inverseTolerance) &&
+           duplicateCell(cloud.y[i], inverseTolerance) == duplicateCell(cloud.y[j], inverseTolerance) &&
+           duplicateCell(cloud.z[i], inverseTolerance) == duplicateCell(cloud.z[j], inverseTolerance);
+}
+
+inline uint64_t duplicateHash(const tPointCloud &cloud, uint32_t i, double inverseTolerance) {
+    uint64_t hash = 0;
+    for (double coord : {cloud.x[i], cloud.y[i], cloud.z[i]}) {
+        double cell = duplicateCell(coord, inverseTolerance);
+        uint64_t bits;
+        memcpy(&bits, &cell, sizeof(bits));
+        hash = (hash ^ bits) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/* Keeps the first of every group of duplicates among ids, which is filtered in place and keeps its order;
+   survivors[k] gets the kept id for the k-th id given. Returns the number of points removed. Hashes of the cells are
+   scattered into buckets by their top bits with one radix pass, then every bucket is sorted by hash and position on
+   its own; only points with equal hashes have their cells compared. */
+inline size_t removeDuplicatePoints(const tPointCloud &cloud, double tolerance, tPointIds &ids, tPointIds &survivors, unsigned workers = 1) {
+    size_t count = ids.size();
+    double inverseTolerance = tolerance > 0 ? 1 / tolerance : 0;
+    const size_t buckets = 1 << radixBits;
+    std::vector<uint64_t> hashes(count);
+    std::vector<size_t> offsets(workers * buckets, 0);
+    parallelFor(workers, count, [&](unsigned w, size_t begin, size_t end) {
+        size_t *local = &offsets[w * buckets];
+        for (size_t i = begin; i < end; i++) {
+            hashes[i] = duplicateHash(cloud, ids[i], inverseTolerance);
+            local[hashes[i] >> (64 - radixBits)]++;
+        }
+    });
+    std::vector<size_t> bucketBegin(buckets + 1);
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < buckets; bucket++) {
+        bucketBegin[bucket] = position;
+        for (unsigned w = 0; w < workers; w++) {
+            size_t size = offsets[w * buckets + bucket];
+            offsets[w * buckets + bucket] = position;
+            position += size;
+        }
+    }
+    bucketBegin[buckets] = position;
+    std::vector<std::pair<uint64_t, uint32_t>> grouped(count);
+    parallelFor(workers, count, [&](unsigned w, size_t begin, size_t end) {
+        size_t *local = &offsets[w * buckets];
+        for (size_t i = begin; i < end; i++)
+            grouped[local[hashes[i] >> (64 - radixBits)]++] = {hashes[i], (uint32_t)i};
+    });
+
+    survivors.resize(count);
+    parallelFor(workers, buckets, [&](unsigned, size_t first, size_t last) {
+        for (size_t bucket = first; bucket < last; bucket++) {
+            auto begin = grouped.begin() + bucketBegin[bucket], end = grouped.begin() + bucketBegin[bucket + 1];
+            std::sort(begin, end);
+            for (auto run = begin; run != end;) {
+                auto next = run;
+                for (; next != end && next->first == run->first; next++) {
+                    uint32_t k = next->second;
+                    survivors[k] = ids[k];
+                    for (auto head = run; head != next; head++)
+                        if (survivors[head->second] == ids[head->second] &&
+                            sameDuplicateCell(cloud, ids[head->second], ids[k], inverseTolerance)) {
+                            survivors[k] = ids[head->second];
+                            break;
+                        }
+                }
+                run = next;
+            }
+        }
+    });
+
+    size_t kept = 0;
+    for (size_t k = 0; k < count; k++)
+        if (survivors[k] == ids[k])
+            ids[kept++] = ids[k];
+    ids.resize(kept);
+    return count - kept;
+}
+
+/* The same over the whole cloud: returns the ids kept, and survivorOf[i] is the id kept for point i. */
+inline tPointIds removeDuplicatePoints(const tPointCloud &cloud, double tolerance, tPointIds &survivorOf, unsigned workers = 1) {
+    tPointIds ids(cloud.x.size());
+    for (uint32_t i = 0; i < ids.size(); i++)
+        ids[i] = i;
+    removeDuplicatePoints(cloud, tolerance, ids, survivorOf, workers);
+    return ids;
+}
+
+inline bool buildHull(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options);
+
+/* Hulls a copy of the points that survive culling and duplicate removal, in Morton order if asked for, then maps
+   the mesh back through the selection so its indices refer to the caller's cloud. */
+inline bool buildHullOnSelection(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options) {
+    unsigned workers = hullWorkers(options, cloud.x.size());
+    tPointIds order;
+    if (options.cullInterior)
+        order = cullInteriorPoints(cloud, epsilon, workers);
+    else {
+        order.resize(cloud.x.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+    }
+    size_t removed = 0;
+    if (options.removeDuplicates) {
+        tPointIds considered, survivors;
+        if (options.duplicateSurvivors)
+            considered = order;
+        removed = removeDuplicatePoints(cloud, options.duplicateTolerance, order, survivors, hullWorkers(options, order.size()));
+        if (options.duplicatesRemoved)
+            *options.duplicatesRemoved = removed;
+        if (options.duplicateSurvivors) {
+            tPointIds &survivorOf = *options.duplicateSurvivors;
+            survivorOf.resize(cloud.x.size());
+            for (uint32_t i = 0; i < survivorOf.size(); i++)
+                survivorOf[i] = i;
+            for (size_t k = 0; k < considered.size(); k++)
+                survivorOf[considered[k]] = survivors[k];
+        }
+    }
+    if (options.spatialOrder)
+        sortByMortonCode(cloud, order, hullWorkers(options, order.size()));
+    tQuickHullOptions selectionOptions = options;
+    selectionOptions.cullInterior = false;
+    selectionOptions.spatialOrder = false;
+    selectionOptions.removeDuplicates = false;
+    if (!buildHull(mesh, selectPoints(cloud, order, hullWorkers(options, order.size())), epsilon, selectionOptions))
+        return false;
+    HULL_STAT(if (options.stats) options.stats->duplicatesRemoved = removed);
+    for (auto &face : mesh.faces)
+        if (!face.deleted)
+            for (auto &vertex : face.vertex)
+                vertex = order[vertex];
+    return true;
+}
+
+/* Builds the hull of the cloud into an empty or reset mesh. Returns false when the cloud spans less than three
+   dimensions. */
+inline bool buildHull(tHullMesh &mesh, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options) {
+    if (cloud.x.empty())
+        return false;
+    if (options.spatialOrder || options.removeDuplicates)
+        return buildHullOnSelection(mesh, cloud, epsilon, options);
+    HULL_STAT(tPhaseClock clock);
+    unsigned workers = hullWorkers(options, cloud.x.size());
+    std::array<uint32_t, 4> simplex = createSimplex(cloud, findExtremePoints(cloud, workers), epsilon, workers);
+    if (simplexDimension(cloud, simplex, epsilon) < 3)
+        return false;
+    HULL_STAT(mesh.scratch.stats = tHullStats());
+    HULL_STAT(clock.lap(mesh.scratch.stats.simplexNs));
+    buildHullOnSimplex(mesh, cloud, epsilon, options, workers, simplex);
+    HULL_STAT(if (options.stats) *options.stats = mesh.scratch.stats);
+    return true;
+}
+
+
+inline void appendMeshFaces(const tHullMesh &mesh, const tPointCloud &cloud, tFaces &faces) {
+    for (auto &face : mesh.faces)
+        if (!face.deleted)
+            faces.push_back({{cloudPoint(cloud, face.vertex[0]), cloudPoint(cloud, face.vertex[1]), cloudPoint(cloud, face.vertex[2])}, {}});
+}
+
+inline tFaces meshFaces(const tHullMesh &mesh, const tPointCloud &cloud) {
+    tFaces faces;
+    appendMeshFaces(mesh, cloud, faces);
+    return faces;
+}
+
+inline tPointIds meshVertices(const tHullMesh &mesh) {
+    tPointIds ids;
+    for (auto &face : mesh.faces)
+        if (!face.deleted)
+            ids.insert(ids.end(), face.vertex, face.vertex + 3);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+inline tFaces quickHull(const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    tHullMesh mesh;
+    if (!buildHull(mesh, cloud, epsilon, options))
+        return {};
+    return meshFaces(mesh, cloud);
+};
+
+inline tFaces quickHull(const vertices& listVertices, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    return quickHull(makePointCloud(listVertices), epsilon, options);
+}
+
+/* Shared-vertex form of a hull: points holds every hull vertex once and inputIds its index in the caller's cloud;
+   triangles holds three indices into points per face, counter-clockwise seen from outside. normals holds the unit
+   normal of each face and adjacent, per face, the faces across its edges 0-1, 1-2 and 2-0; both stay empty unless
+   asked for. */
+typedef struct {
+    vertices points;
+    tPointIds inputIds;
+    tPointIds triangles;
+    vertices normals;
+    tPointIds adjacent;
+} tIndexedHull;
+
+inline void indexMeshFaces(const tHullMesh &mesh, const tPointCloud &cloud, bool withNormals, bool withAdjacency, tIndexedHull &hull) {
+    hull.inputIds = meshVertices(mesh);
+    hull.points.clear();
+    hull.points.reserve(hull.inputIds.size());
+    for (auto id : hull.inputIds)
+        hull.points.push_back(cloudPoint(cloud, id));
+    tPointIds faceIndex(mesh.faces.size());
+    size_t count = 0;
+    for (size_t id = 0; id < mesh.faces.size(); id++)
+        if (!mesh.faces[id].deleted)
+            faceIndex[id] = (uint32_t)count++;
+    hull.triangles.clear();
+    hull.triangles.reserve(3 * count);
+    hull.normals.clear();
+    hull.adjacent.clear();
+    for (auto &face : mesh.faces) {
+        if (face.deleted)
+            continue;
+        for (int i = 0; i < 3; i++) {
+            auto vertex = std::lower_bound(hull.inputIds.begin(), hull.inputIds.end(), face.vertex[i]);
+            hull.triangles.push_back((uint32_t)(vertex - hull.inputIds.begin()));
+        }
+        if (withNormals)
+            hull.normals.push_back(face.normal);
+        if (withAdjacency)
+            for (int i = 0; i < 3; i++)
+                hull.adjacent.push_back(faceIndex[face.adjacent[i]]);
+    }
+}
+
+/* Empty when the cloud spans fewer than three dimensions. */
+inline tIndexedHull quickHullIndexed(const tPointCloud &cloud, double epsilon, bool withNormals, bool withAdjacency,
+                              const tQuickHullOptions &options = tQuickHullOptions()) {
+    tIndexedHull hull;
+    tHullMesh mesh;
+    if (buildHull(mesh, cloud, epsilon, options))
+        indexMeshFaces(mesh, cloud, withNormals, withAdjacency, hull);
+    return hull;
+}
+
+inline tIndexedHull quickHullIndexed(const vertices &listVertices, double epsilon, bool withNormals, bool withAdjacency,
+                              const tQuickHullOptions &options = tQuickHullOptions()) {
+    return quickHullIndexed(makePointCloud(listVertices), epsilon, withNormals, withAdjacency, options);
+}
+
+/* Everything a hull build allocates: the face pool with its conflict lists, the expansion scratch, a copy of the
+   input and the output faces. Their capacity is kept between calls, so once the workspace has seen inputs of the
+   current size a build without culling or extra threads does not touch the allocator; the exact orientation
+   fallback sums on the stack. */
+typedef struct {
+    tHullMesh mesh;
+    tPointCloud cloud;
+    tFaces faces;
+} tHullWorkspace;
+
+/* The returned faces belong to the workspace and stay valid until its next build. */
+inline const tFaces &quickHull(tHullWorkspace &workspace, const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    resetHullMesh(workspace.mesh);
+    workspace.faces.clear();
+    if (buildHull(workspace.mesh, cloud, epsilon, options))
+        appendMeshFaces(workspace.mesh, cloud, workspace.faces);
+    return workspace.faces;
+}
+
+inline const tFaces &quickHull(tHullWorkspace &workspace, const vertices &listVertices, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    fillPointCloud(listVertices, workspace.cloud);
+    return quickHull(workspace, workspace.cloud, epsilon, options);
+}
+
+/* Andrew's monotone chain over the cloud projected along the dominant axis of normal. Corners within epsilon of the
+   chain in the projection are dropped; the rest are returned counter-clockwise around normal. */
+inline tPointIds planarHull(const tPointCloud &cloud, const corecvs::Vector3dd &normal, double epsilon) {
+    int axis = fabs(normal.x()) >= fabs(normal.y()) ? (fabs(normal.x()) >= fabs(normal.z()) ? 0 : 2)
+                                                    : (fabs(normal.y()) >= fabs(normal.z()) ? 1 : 2);
+    const std::vector<double> &u = axis == 0 ? cloud.y : (axis == 1 ? cloud.z : cloud.x);
+    const std::vector<double> &v = axis == 0 ? cloud.z : (axis == 1 ? cloud.x : cloud.y);
+    tPointIds ids(cloud.x.size());
+    for (uint32_t i = 0; i < ids.size(); i++)
+        ids[i] = i;
+    std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) { return u[a] < u[b] || (u[a] == u[b] && v[a] < v[b]); });
+    auto turnsLeft = [&](uint32_t o, uint32_t a, uint32_t b) {
+        double cross = (u[a] - u[o]) * (v[b] - v[o]) - (v[a] - v[o]) * (u[b] - u[o]);
+        return cross > std::max(epsilon, 0.0) * hypot(u[b] - u[o], v[b] - v[o]);
+    };
+    tPointIds chain(2 * ids.size());
+    size_t k = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        while (k >= 2 && !turnsLeft(chain[k - 2], chain[k - 1], ids[i]))
+            k--;
+        chain[k++] = ids[i];
+    }
+    for (size_t i = ids.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && !turnsLeft(chain[k - 2], chain[k - 1], ids[i]))
+            k--;
+        chain[k++] = ids[i];
+    }
+    chain.resize(k > 1 ? k - 1 : k);
+    if ((axis == 0 ? normal.x() : (axis == 1 ? normal.y() : normal.z())) < 0)
+        std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+enum tHullKind { hullEmpty, hullPoint, hullSegment, hullPolygon, hullPolyhedron };
+
+/* points holds the point, the two ends of the segment or the polygon corners counter-clockwise around normal;
+   faces is only filled for a polyhedron. */
+typedef struct {
+    tHullKind kind;
+    vertices points;
+    corecvs::Vector3dd normal;
+    tFaces faces;
+} tHull;
+
+/* Like quickHull, but input spanning fewer than three dimensions gives its point, segment or planar polygon. Solids
+   go through buildHull with the same options; the kind stays hullEmpty if a duplicate tolerance flattens them. */
+inline tHull convexHull(const tPointCloud &cloud, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    tHull hull;
+    hull.kind = hullEmpty;
+    hull.normal = {0, 0, 0};
+    if (cloud.x.empty())
+        return hull;
+    unsigned workers = hullWorkers(options, cloud.x.size());
+    std::array<uint32_t, 4> simplex = createSimplex(cloud, findExtremePoints(cloud, workers), epsilon, workers);
+    corecvs::Vector3dd p0 = cloudPoint(cloud, simplex[0]), p1 = cloudPoint(cloud, simplex[1]), p2 = cloudPoint(cloud, simplex[2]);
+    if (pointDist(p0, p2) > pointDist(p0, p1))
+        std::swap(p1, p2);
+    switch (simplexDimension(cloud, simplex, epsilon)) {
+    case 0:
+        hull.kind = hullPoint;
+        hull.points = {p0};
+        break;
+    case 1:
+        hull.kind = hullSegment;
+        hull.points = {p0, p1};
+        break;
+    case 2: {
+        corecvs::Vector3dd normal = vectProd(createVect(p0, p1), createVect(p0, p2));
+        double normalMod = vectMod(normal);
+        hull.kind = hullPolygon;
+        hull.normal = {normal.x() / normalMod, normal.y() / normalMod, normal.z() / normalMod};
+        for (auto id : planarHull(cloud, hull.normal, epsilon))
+            hull.points.push_back(cloudPoint(cloud, id));
+        break;
+    }
+    default: {
+        tHullMesh mesh;
+        if (buildHull(mesh, cloud, epsilon, options)) {
+            hull.kind = hullPolyhedron;
+            hull.faces = meshFaces(mesh, cloud);
+        }
+    }
+    }
+    return hull;
+}
+
+inline tHull convexHull(const vertices &listVertices, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    return convexHull(makePointCloud(listVertices), epsilon, options);
+}
+
+/* faces is empty when the cloud spans fewer than three dimensions. Every point left outside the hull lies at most
+   error above the plane of the face it was assigned to; error is zero when the hull is complete. */
+typedef struct {
+    tFaces faces;
+    double error;
+    size_t vertexCount;
+} tApproximateHull;
+
+/* Anytime hull: points are added furthest first until every point left outside lies within tolerance of its face
+   or the hull has maxVertices vertices; either limit can be switched off with 0. */
+inline tApproximateHull approximateHull(const tPointCloud &cloud, double epsilon, double tolerance, size_t maxVertices,
+                                 const tQuickHullOptions &options = tQuickHullOptions()) {
+    tApproximateHull hull = {{}, 0, 0};
+    if (cloud.x.empty())
+        return hull;
+    unsigned workers = hullWorkers(options, cloud.x.size());
+    std::array<uint32_t, 4> simplex = createSimplex(cloud, findExtremePoints(cloud, workers), epsilon, workers);
+    if (simplexDimension(cloud, simplex, epsilon) < 3)
+        return hull;
+    tHullMesh mesh;
+    HULL_STAT(mesh.scratch.stats = tHullStats());
+    const std::vector<int> &simplexFaces = startHullOnSimplex(mesh, cloud, epsilon, options, workers, simplex);
+    hull.error = expandFurthestFirst(mesh, cloud, epsilon, simplexFaces, tolerance, maxVertices);
+    HULL_STAT(if (options.stats) *options.stats = mesh.scratch.stats);
+    hull.faces = meshFaces(mesh, cloud);
+    hull.vertexCount = meshVertices(mesh).size();
+    return hull;
+}
+
+inline tApproximateHull approximateHull(const vertices &listVertices, double epsilon, double tolerance, size_t maxVertices,
+                                 const tQuickHullOptions &options = tQuickHullOptions()) {
+    return approximateHull(makePointCloud(listVertices), epsilon, tolerance, maxVertices, options);
+}
+
+inline tPointCloud sliceCloud(const tPointCloud &cloud, size_t begin, size_t end) {
+    tPointCloud slice;
+    slice.x.assign(cloud.x.begin() + begin, cloud.x.begin() + end);
+    slice.y.assign(cloud.y.begin() + begin, cloud.y.begin() + end);
+    slice.z.assign(cloud.z.begin() + begin, cloud.z.begin() + end);
+    return slice;
+}
+
+/* float32 input: only the culling pass reads the floats, at twice the lanes of doubles; the points it keeps go to the
+   double engine, whose simplex, partition kernels and mesh stay in double. Without options.cullInterior every point is
+   converted, which costs the same as building a double cloud, so float input only pays off together with culling.
+   The duplicate map is translated back to ids of the float cloud. */
+inline tFaces quickHull(const tPointCloudOf<float> &cloud, double epsilon, const tQuickHullOptions &options = tQuickHullOptions()) {
+    if (cloud.x.empty())
+        return {};
+    unsigned workers = hullWorkers(options, cloud.x.size());
+    tPointIds ids;
+    if (options.cullInterior)
+        ids = cullInteriorPoints(cloud, epsilon, workers);
+    else {
+        ids.resize(cloud.x.size());
+        for (uint32_t i = 0; i < ids.size(); i++)
+            ids[i] = i;
+    }
+    tQuickHullOptions survivorOptions = options;
+    survivorOptions.cullInterior = false;
+    tFaces faces = quickHull(selectPoints(cloud, ids, workers), epsilon, survivorOptions);
+    if (options.cullInterior && options.removeDuplicates && options.duplicateSurvivors) {
+        tPointIds selected;
+        selected.swap(*options.duplicateSurvivors);
+        tPointIds &survivorOf = *options.duplicateSurvivors;
+        survivorOf.resize(cloud.x.size());
+        for (uint32_t i = 0; i < survivorOf.size(); i++)
+            survivorOf[i] = i;
+        for (size_t k = 0; k < selected.size(); k++)
+            survivorOf[ids[k]] = ids[selected[k]];
+    }
+    return faces;
+}
+
+const size_t minPointsPerChunk = 64;
+
+/* Divide and conquer: every thread hulls its own chunk of the input, then the hull of the union of the chunk hull
+   vertices is the hull of the whole input. Chunks that turn out flat keep all of their points. */
+inline tFaces quickHullParallel(const vertices &listVertices, double epsilon, unsigned threads) {
+    tPointCloud cloud = makePointCloud(listVertices);
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    tQuickHullOptions options;
+    options.threads = threads;
+    options.cullInterior = true;
+    if (threads == 1 || cloud.x.size() < threads * minPointsPerChunk)
+        return quickHull(cloud, epsilon, options);
+
+    std::vector<tPointIds> chunkVertices(threads);
+    parallelFor(threads, cloud.x.size(), [&](unsigned w, size_t begin, size_t end) {
+        tPointCloud chunk = sliceCloud(cloud, begin, end);
+        tQuickHullOptions chunkOptions;
+        chunkOptions.threads = 1;
+        chunkOptions.cullInterior = true;
+        tHullMesh mesh;
+        if (buildHull(mesh, chunk, epsilon, chunkOptions))
+            chunkVertices[w] = meshVertices(mesh);
+        else {
+            chunkVertices[w].resize(chunk.x.size());
+            for (uint32_t i = 0; i < chunkVertices[w].size(); i++)
+                chunkVertices[w][i] = i;
+        }
+        for (auto &id : chunkVertices[w])
+            id += (uint32_t)begin;
+    });
+
+    tPointIds survivors;
+    for (auto &ids : chunkVertices)
+        survivors.insert(survivors.end(), ids.begin(), ids.end());
+    return quickHull(selectPoints(cloud, survivors), epsilon, options);
+}
+
+/* Persistent pool for batches of small hulls. Every worker keeps its own workspace between jobs, so once it has
+   grown to the largest object seen a hull allocates nothing. The calling thread is worker 0. */
+struct tHullPool {
+    std::vector<std::thread> threads;
+    std::vector<tHullWorkspace> workspaces;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned)> *job;
+    unsigned round;
+    unsigned busy;
+    bool stopping;
+
+    explicit tHullPool(unsigned workers = 0);
+    ~tHullPool();
+};
+
+inline void runPoolWorker(tHullPool &pool, unsigned w) {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(pool.lock);
+    for (;;) {
+        pool.wake.wait(lock, [&pool, seen]() { return pool.stopping || pool.round != seen; });
+        if (pool.stopping)
+            return;
+        seen = pool.round;
+        lock.unlock();
+        (*pool.job)(w);
+        lock.lock();
+        if (--pool.busy == 0)
+            pool.done.notify_all();
+    }
+}
+
+inline tHullPool::tHullPool(unsigned workers) : job(nullptr), round(0), busy(0), stopping(false) {
+    if (workers == 0)
+        workers = std::max(std::thread::hardware_concurrency(), 1u);
+    workspaces.resize(workers);
+    for (unsigned w = 1; w < workers; w++)
+        threads.emplace_back(runPoolWorker, std::ref(*this), w);
+}
+
+inline tHullPool::~tHullPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : threads)
+        worker.join();
+}
+
+/* Runs job(worker) once on every worker of the pool and returns when all of them are done. */
+inline void runOnPool(tHullPool &pool, const std::function<void(unsigned)> &job) {
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.job = &job;
+        pool.busy = (unsigned)pool.threads.size();
+        pool.round++;
+    }
+    pool.wake.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(pool.lock);
+    pool.done.wait(lock, [&pool]() { return pool.busy == 0; });
+}
+
+/* Object k of a batch owns points [offsets[k], offsets[k + 1]) of the batch cloud. Its faces are faceCount[k]
+   triples of cloud indices starting at triangles[3 * faceBegin[k]]; every object has room for the 2n - 4 faces n
+   points can give, so workers write their results in place. Objects spanning fewer than three dimensions get no
+   faces. */
+typedef struct {
+    tPointIds triangles;
+    std::vector<size_t> faceBegin;
+    std::vector<uint32_t> faceCount;
+} tHullBatch;
+
+const size_t batchObjectsPerClaim = 16;
+
+inline uint32_t hullBatchObject(tHullWorkspace &workspace, const tPointCloud &cloud, size_t begin, size_t end, double epsilon, uint32_t *triangles) {
+    workspace.cloud.x.assign(cloud.x.begin() + begin, cloud.x.begin() + end);
+    workspace.cloud.y.assign(cloud.y.begin() + begin, cloud.y.begin() + end);
+    workspace.cloud.z.assign(cloud.z.begin() + begin, cloud.z.begin() + end);
+    resetHullMesh(workspace.mesh);
+    tQuickHullOptions options;
+    options.threads = 1;
+    if (!buildHull(workspace.mesh, workspace.cloud, epsilon, options))
+        return 0;
+    uint32_t count = 0;
+    for (auto &face : workspace.mesh.faces)
+        if (!face.deleted) {
+            for (int i = 0; i < 3; i++)
+                triangles[3 * count + i] = (uint32_t)begin + face.vertex[i];
+            count++;
+        }
+    return count;
+}
+
+inline void quickHullBatch(tHullPool &pool, const tPointCloud &cloud, const std::vector<size_t> &offsets, double epsilon, tHullBatch &batch) {
+    size_t objects = offsets.empty() ? 0 : offsets.size() - 1;
+    batch.faceBegin.resize(objects + 1);
+    batch.faceCount.assign(objects, 0);
+    batch.faceBegin[0] = 0;
+    for (size_t k = 0; k < objects; k++) {
+        size_t points = offsets[k + 1] - offsets[k];
+        batch.faceBegin[k + 1] = batch.faceBegin[k] + (points > 3 ? 2 * points - 4 : 0);
+    }
+    batch.triangles.resize(3 * batch.faceBegin[objects]);
+
+    std::atomic<size_t> next(0);
+    std::function<void(unsigned)> job = [&](unsigned w) {
+        for (;;) {
+            size_t first = next.fetch_add(batchObjectsPerClaim);
+            if (first >= objects)
+                break;
+            for (size_t k = first; k < std::min(objects, first + batchObjectsPerClaim); k++)
+                if (offsets[k + 1] - offsets[k] > 3)
+                    batch.faceCount[k] = hullBatchObject(pool.workspaces[w], cloud, offsets[k], offsets[k + 1], epsilon,
+                                                         batch.triangles.data() + 3 * batch.faceBegin[k]);
+        }
+    };
+    runOnPool(pool, job);
+}
+
+/* Out-of-core input: a flat binary file of x, y, z triples of tCoord, mapped read-only and read in chunks of
+   fileChunkPoints. The first pass finds the culling extremes, the second keeps the points outside their polytope;
+   only those are copied before the hull runs. Chunks already read are dropped from the mapping so resident memory
+   stays around one chunk plus the survivors. */
+const size_t fileChunkPoints = 1 << 20;
+
+template <typename tCoord>
+void readFileChunk(const tCoord *data, size_t begin, size_t end, tPointCloudOf<tCoord> &chunk) {
+    size_t count = end - begin;
+    chunk.x.resize(count);
+    chunk.y.resize(count);
+    chunk.z.resize(count);
+    const tCoord *point = data + 3 * begin;
+    for (size_t i = 0; i < count; i++, point += 3) {
+        chunk.x[i] = point[0];
+        chunk.y[i] = point[1];
+        chunk.z[i] = point[2];
+    }
+}
+
+#ifdef QUICKHULL_MMAP
+inline void dropFileChunk(const void *data, size_t bytesBegin, size_t bytesEnd) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = (bytesBegin + page - 1) / page * page, last = bytesEnd / page * page;
+    if (last > first)
+        madvise((char *)data + first, last - first, MADV_DONTNEED);
+}
+#endif
+
+/* Returns false with errno set when the file cannot be read: the open, fstat or mmap error, EINVAL when its size
+   is not a whole number of xyz triples and ENOSYS without mmap. A readable file of points spanning fewer than three
+   dimensions returns true with no faces. */
+template <typename tCoord>
+bool quickHullFile(const char *path, double epsilon, tFaces &faces, const tQuickHullOptions &options = tQuickHullOptions()) {
+    faces.clear();
+#ifdef QUICKHULL_MMAP
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    int error = fstat(file, &info) != 0 ? errno : 0;
+    if (!error && (info.st_size == 0 || info.st_size % (3 * sizeof(tCoord)) != 0))
+        error = EINVAL;
+    if (error) {
+        close(file);
+        errno = error;
+        return false;
+    }
+    size_t bytes = (size_t)info.st_size, count = bytes / (3 * sizeof(tCoord));
+    void *mapping = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, file, 0);
+    error = errno;
+    close(file);
+    if (mapping == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+    madvise(mapping, bytes, MADV_SEQUENTIAL);
+    const tCoord *data = (const tCoord *)mapping;
+    size_t pointBytes = 3 * sizeof(tCoord);
+    tPointCloudOf<tCoord> chunk;
+
+    tPointCloudOf<tCoord> corners;
+    corners.x.resize(2 * cullingAxes);
+    corners.y.resize(2 * cullingAxes);
+    corners.z.resize(2 * cullingAxes);
+    std::array<double, 2 * cullingAxes> extent;
+    resetCullingExtent(extent.data());
+    for (size_t begin = 0; begin < count; begin += fileChunkPoints) {
+        size_t end = std::min(count, begin + fileChunkPoints);
+        readFileChunk(data, begin, end, chunk);
+        tCullingExtremes local;
+        std::array<double, 2 * cullingAxes> localExtent = extent;
+        local.fill(0);
+        scanCullingExtremes(chunk, 0, end - begin, local, localExtent.data());
+        for (int k = 0; k < 2 * cullingAxes; k++)
+            if (localExtent[k] != extent[k]) {
+                extent[k] = localExtent[k];
+                corners.x[k] = chunk.x[local[k]];
+                corners.y[k] = chunk.y[local[k]];
+                corners.z[k] = chunk.z[local[k]];
+            }
+        dropFileChunk(mapping, begin * pointBytes, end * pointBytes);
+    }
+
+    tCullingPolytopeOf<tCoord> polytope;
+    tPointIds cornerIds(corners.x.size());
+    for (uint32_t i = 0; i < cornerIds.size(); i++)
+        cornerIds[i] = i;
+    bool culling = buildCullingPolytope(corners, cornerIds, epsilon, polytope);
+    tPointCloud candidates;
+    for (size_t begin = 0; begin < count; begin += fileChunkPoints) {
+        size_t end = std::min(count, begin + fileChunkPoints);
+        readFileChunk(data, begin, end, chunk);
+        tPointIds survivors;
+        if (culling)
+            survivors = cullRange(chunk, polytope, epsilon, hullWorkers(options, end - begin), 0, end - begin);
+        else
+            for (uint32_t i = 0; i < end - begin; i++)
+                survivors.push_back(i);
+        for (auto id : survivors) {
+            candidates.x.push_back(chunk.x[id]);
+            candidates.y.push_back(chunk.y[id]);
+            candidates.z.push_back(chunk.z[id]);
+        }
+        dropFileChunk(mapping, begin * pointBytes, end * pointBytes);
+    }
+    munmap(mapping, bytes);
+    chunk = tPointCloudOf<tCoord>();
+    faces = quickHull(candidates, epsilon, options);
+    return true;
+#else
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+/* Hull that grows batch by batch. The mesh, the cloud of points that may still matter and the extreme points along
+   the culling axes persist between batches, so a batch costs a culling pass over its own points plus the expansion of
+   the faces they see. The hull is first built once the points span three dimensions. */
+struct tIncrementalHull {
+    double epsilon;
+    tQuickHullOptions options;
+    tPointCloud cloud;
+    tHullMesh mesh;
+    bool built;
+    corecvs::Vector3dd centre;
+    tCullingExtremes extremes;
+    std::array<double, 2 * cullingAxes> extent;
+    int lastFace;
+    size_t compactedSize;
+
+    tIncrementalHull(double epsilon, const tQuickHullOptions &options = tQuickHullOptions())
+        : epsilon(epsilon), options(options), built(false), lastFace(0), compactedSize(0) {}
+};
+
+/* Walks from face to face towards the one maximising dist / (offset - normal * centre). With the centre strictly
+   inside the hull these are the vertices of the polar polytope, so the walk is a simplex ascent and ends at the face
+   the point lies furthest outside of, relative to its distance from the centre. */
+inline int locateFace(const tIncrementalHull &hull, uint32_t point, int start) {
+    const tHullMesh &mesh = hull.mesh;
+    auto score = [&](int id) {
+        const tMeshFace &face = mesh.faces[id];
+        double depth = face.offset - scalarProd(face.normal, hull.centre);
+        return depth > 0 ? pointFaceDist(face, hull.cloud, point) / depth : -HUGE_VAL;
+    };
+    int current = start;
+    double best = score(current);
+    for (bool moved = true; moved;) {
+        moved = false;
+        const tMeshFace &face = mesh.faces[current];
+        for (int i = 0; i < 3; i++) {
+            double next = score(face.adjacent[i]);
+            if (next > best) {
+                best = next;
+                current = face.adjacent[i];
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+/* The face the point lies furthest outside of among those it sees from start on. The located face maximises distance
+   over depth, so a point can graze it while lying far outside a face that is not adjacent; searching the faces it
+   sees finds that one. */
+inline int furthestSeenFace(tHullMesh &mesh, const tPointCloud &cloud, uint32_t point, int start) {
+    unsigned stamp = ++mesh.iteration;
+    std::vector<int> &region = mesh.scratch.visibleFaces;
+    region.assign(1, start);
+    mesh.faces[start].visited = stamp;
+    int best = start;
+    double bestDist = pointFaceDist(mesh.faces[start], cloud, point);
+    for (size_t k = 0; k < region.size(); k++)
+        for (int i = 0; i < 3; i++) {
+            int id = mesh.faces[region[k]].adjacent[i];
+            tMeshFace &neighbour = mesh.faces[id];
+            if (neighbour.visited == stamp)
+                continue;
+            neighbour.visited = stamp;
+            double dist = pointFaceDist(neighbour, cloud, point);
+            if (dist <= 0)
+                continue;
+            region.push_back(id);
+            if (dist > bestDist) {
+                bestDist = dist;
+                best = id;
+            }
+        }
+    return best;
+}
+
+inline void addConflictPoint(tMeshFace &face, uint32_t point, double dist) {
+    face.points.push_back(point);
+    if (dist > face.furthestDist) {
+        face.furthestDist = dist;
+        face.furthest = point;
+    }
+}
+
+/* Drops the points that are neither hull vertices nor culling extremes and renumbers the mesh to match. */
+inline void compactIncrementalHull(tIncrementalHull &hull) {
+    tPointIds keep = meshVertices(hull.mesh);
+    keep.insert(keep.end(), hull.extremes.begin(), hull.extremes.end());
+    std::sort(keep.begin(), keep.end());
+    keep.erase(std::unique(keep.begin(), keep.end()), keep.end());
+    auto renumber = [&](uint32_t id) { return (uint32_t)(std::lower_bound(keep.begin(), keep.end(), id) - keep.begin()); };
+    for (auto &face : hull.mesh.faces)
+        if (!face.deleted)
+            for (int i = 0; i < 3; i++)
+                face.vertex[i] = renumber(face.vertex[i]);
+    for (auto &id : hull.extremes)
+        id = renumber(id);
+    hull.cloud = selectPoints(hull.cloud, keep);
+    hull.compactedSize = keep.size();
+}
+
+inline void startIncrementalHull(tIncrementalHull &hull) {
+    tHullMesh mesh;
+    if (!buildHull(mesh, hull.cloud, hull.epsilon, hull.options))
+        return;
+    hull.mesh = std::move(mesh);
+    hull.built = true;
+    tPointIds corners = meshVertices(hull.mesh);
+    double x = 0, y = 0, z = 0;
+    for (auto id : corners) {
+        x += hull.cloud.x[id];
+        y += hull.cloud.y[id];
+        z += hull.cloud.z[id];
+    }
+    hull.centre = {x / corners.size(), y / corners.size(), z / corners.size()};
+    hull.extremes.fill(0);
+    resetCullingExtent(hull.extent.data());
+    scanCullingExtremes(hull.cloud, 0, hull.cloud.x.size(), hull.extremes, hull.extent.data());
+    compactIncrementalHull(hull);
+}
+
+/* Adds a batch of points to the hull. Points inside the culling polytope are rejected outright; every other point
+   is handed to the face the locating walk ends at, or one of its neighbours, if it lies outside it, and only those
+   faces are expanded. A point within the tolerance of both but outside the hull is handed to the face of its visible
+   region it lies furthest outside of. */
+inline void insertBatch(tIncrementalHull &hull, const vertices &batch) {
+    size_t first = hull.cloud.x.size();
+    for (auto &vertex : batch) {
+        hull.cloud.x.push_back(vertex.x());
+        hull.cloud.y.push_back(vertex.y());
+        hull.cloud.z.push_back(vertex.z());
+    }
+    if (!hull.built) {
+        startIncrementalHull(hull);
+        return;
+    }
+
+    size_t last = hull.cloud.x.size();
+    scanCullingExtremes(hull.cloud, first, last, hull.extremes, hull.extent.data());
+    tCullingPolytope polytope;
+    tPointIds candidates;
+    unsigned workers = hullWorkers(hull.options, batch.size());
+    if (buildCullingPolytope(hull.cloud, tPointIds(hull.extremes.begin(), hull.extremes.end()), hull.epsilon, polytope))
+        candidates = cullRange(hull.cloud, polytope, hull.epsilon, workers, first, last);
+    else
+        for (size_t i = first; i < last; i++)
+            candidates.push_back((uint32_t)i);
+
+    tHullMesh &mesh = hull.mesh;
+    if (mesh.faces[hull.lastFace].deleted)
+        for (hull.lastFace = 0; mesh.faces[hull.lastFace].deleted; hull.lastFace++)
+            ;
+    std::vector<int> conflictFaces;
+    for (auto point : candidates) {
+        int located = locateFace(hull, point, hull.lastFace), id = located;
+        hull.lastFace = located;
+        double dist = pointFaceDist(mesh.faces[id], hull.cloud, point);
+        for (int i = 0; i < 3 && dist <= hull.epsilon; i++) {
+            int neighbour = mesh.faces[located].adjacent[i];
+            double neighbourDist = pointFaceDist(mesh.faces[neighbour], hull.cloud, point);
+            if (neighbourDist > dist) {
+                id = neighbour;
+                dist = neighbourDist;
+            }
+        }
+        if (dist > 0 && dist <= hull.epsilon) {
+            id = furthestSeenFace(mesh, hull.cloud, point, id);
+            dist = pointFaceDist(mesh.faces[id], hull.cloud, point);
+        }
+        if (hull.epsilon > 0 ? dist <= hull.epsilon : !faceIsVisible(hull.cloud, point, mesh.faces[id]))
+            continue;
+        if (mesh.faces[id].points.empty())
+            conflictFaces.push_back(id);
+        addConflictPoint(mesh.faces[id], point, dist);
+    }
+    expandHull(mesh, hull.cloud, hull.epsilon, hull.options.threads ? hull.options.threads : workers, hull.options, conflictFaces);
+    if (hull.cloud.x.size() > 2 * hull.compactedSize + minPointsPerWorker)
+        compactIncrementalHull(hull);
+}
+
+inline tFaces incrementalHullFaces(const tIncrementalHull &hull) {
+    if (!hull.built)
+        return {};
+    return meshFaces(hull.mesh, hull.cloud);
+}
+
+/* Hull of a changing set of points. Points are grouped into blocks by arrival, and every block keeps the hull
+   vertices of its own live points; the hull of the whole set is the hull of those vertices. Deleting a point that
+   is not a vertex of its block only marks it dead, deleting a vertex rebuilds that block from the points it kept,
+   and a sliding window drops whole blocks from the front. The merged hull is kept too: as long as none of its own
+   vertices is deleted it can only grow, so a query hulls its vertices together with those of the rebuilt blocks.
+   Only deleting one of its vertices makes a query hull the vertices of every block again. */
+typedef struct {
+    tPointCloud cloud;
+    std::vector<bool> alive;
+    std::vector<bool> onHull;
+    std::vector<bool> onMergedHull;
+    tPointIds vertices;
+    size_t aliveCount;
+    bool dirty;
+} tHullBlock;
+
+struct tDynamicHull {
+    double epsilon;
+    size_t blockSize;
+    tQuickHullOptions options;
+    std::deque<tHullBlock> blocks;
+    uint64_t firstId;
+    uint64_t nextId;
+    uint64_t oldestId;
+    size_t aliveCount;
+    bool changed;
+    bool mergedHullLost;
+    std::vector<uint64_t> mergedVertices;
+    tFaces faces;
+
+    tDynamicHull(double epsilon, size_t blockSize = 4096, const tQuickHullOptions &options = tQuickHullOptions())
+        : epsilon(epsilon), blockSize(blockSize), options(options), firstId(0), nextId(0), oldestId(0), aliveCount(0),
+          changed(false), mergedHullLost(true) {}
+};
+
+inline uint64_t insertPoint(tDynamicHull &hull, const corecvs::Vector3dd &point) {
+    if (hull.blocks.empty() || hull.blocks.back().alive.size() == hull.blockSize) {
+        if (hull.blocks.empty())
+            hull.firstId = hull.nextId;
+        hull.blocks.push_back(tHullBlock());
+        hull.blocks.back().aliveCount = 0;
+    }
+    tHullBlock &block = hull.blocks.back();
+    block.cloud.x.push_back(point.x());
+    block.cloud.y.push_back(point.y());
+    block.cloud.z.push_back(point.z());
+    block.alive.push_back(true);
+    block.onHull.push_back(false);
+    block.onMergedHull.push_back(false);
+    block.aliveCount++;
+    block.dirty = true;
+    hull.aliveCount++;
+    hull.changed = true;
+    return hull.nextId++;
+}
+
+/* Returns false when id is not a live point of the hull. */
+inline bool erasePoint(tDynamicHull &hull, uint64_t id) {
+    if (id < hull.firstId || id >= hull.nextId)
+        return false;
+    tHullBlock &block = hull.blocks[(id - hull.firstId) / hull.blockSize];
+    size_t slot = (id - hull.firstId) % hull.blockSize;
+    if (!block.alive[slot])
+        return false;
+    block.alive[slot] = false;
+    block.aliveCount--;
+    hull.aliveCount--;
+    if (block.onHull[slot]) {
+        block.dirty = true;
+        hull.changed = true;
+    }
+    if (block.onMergedHull[slot]) {
+        hull.mergedHullLost = true;
+        hull.changed = true;
+    }
+    while (!hull.blocks.empty() && hull.blocks.front().aliveCount == 0 &&
+           (hull.blocks.size() > 1 || hull.blocks.front().alive.size() == hull.blockSize)) {
+        hull.blocks.pop_front();
+        hull.firstId += hull.blockSize;
+    }
+    return true;
+}
+
+/* Adds the arrivals and then expires the oldest live points until at most window points remain. */
+inline void slideWindow(tDynamicHull &hull, const vertices &arrivals, size_t window) {
+    for (auto &point : arrivals)
+        insertPoint(hull, point);
+    while (hull.aliveCount > window) {
+        hull.oldestId = std::max(hull.oldestId, hull.firstId);
+        erasePoint(hull, hull.oldestId++);
+    }
+}
+
+inline void rebuildBlock(tHullBlock &block, double epsilon) {
+    tPointIds ids;
+    for (uint32_t i = 0; i < block.alive.size(); i++) {
+        block.onHull[i] = false;
+        if (block.alive[i])
+            ids.push_back(i);
+    }
+    block.dirty = false;
+    tQuickHullOptions options;
+    options.threads = 1;
+    options.cullInterior = true;
+    tHullMesh mesh;
+    block.vertices.clear();
+    if (ids.size() > 3 && buildHull(mesh, selectPoints(block.cloud, ids), epsilon, options))
+        for (auto vertex : meshVertices(mesh))
+            block.vertices.push_back(ids[vertex]);
+    else
+        block.vertices = ids;
+    for (auto slot : block.vertices)
+        block.onHull[slot] = true;
+}
+
+/* Hulls the vertices of the merged hull with those of the rebuilt blocks, or the vertices of every block when the
+   merged hull lost one of its own. */
+inline const tFaces &dynamicHullFaces(tDynamicHull &hull) {
+    if (!hull.changed)
+        return hull.faces;
+    std::vector<size_t> dirty;
+    for (size_t k = 0; k < hull.blocks.size(); k++)
+        if (hull.blocks[k].dirty)
+            dirty.push_back(k);
+    unsigned workers = std::max(1u, std::min((unsigned)dirty.size(), hull.options.threads ? hull.options.threads : std::thread::hardware_concurrency()));
+    parallelFor(workers, dirty.size(), [&](unsigned, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++)
+            rebuildBlock(hull.blocks[dirty[k]], hull.epsilon);
+    });
+
+    tPointCloud corners;
+    std::vector<uint64_t> cornerIds;
+    auto addCorner = [&](size_t k, uint32_t slot) {
+        const tHullBlock &block = hull.blocks[k];
+        corners.x.push_back(block.cloud.x[slot]);
+        corners.y.push_back(block.cloud.y[slot]);
+        corners.z.push_back(block.cloud.z[slot]);
+        cornerIds.push_back(hull.firstId + k * hull.blockSize + slot);
+    };
+    if (hull.mergedHullLost) {
+        for (size_t k = 0; k < hull.blocks.size(); k++)
+            for (auto slot : hull.blocks[k].vertices)
+                addCorner(k, slot);
+    } else {
+        for (auto id : hull.mergedVertices)
+            addCorner((id - hull.firstId) / hull.blockSize, (uint32_t)((id - hull.firstId) % hull.blockSize));
+        for (auto k : dirty)
+            for (auto slot : hull.blocks[k].vertices)
+                if (!hull.blocks[k].onMergedHull[slot])
+                    addCorner(k, slot);
+    }
+    for (auto id : hull.mergedVertices)
+        if (id >= hull.firstId)
+            hull.blocks[(id - hull.firstId) / hull.blockSize].onMergedHull[(id - hull.firstId) % hull.blockSize] = false;
+    hull.mergedVertices.clear();
+
+    tHullMesh mesh;
+    hull.faces.clear();
+    hull.mergedHullLost = !buildHull(mesh, corners, hull.epsilon, hull.options);
+    if (!hull.mergedHullLost) {
+        appendMeshFaces(mesh, corners, hull.faces);
+        for (auto vertex : meshVertices(mesh)) {
+            uint64_t id = cornerIds[vertex];
+            hull.mergedVertices.push_back(id);
+            hull.blocks[(id - hull.firstId) / hull.blockSize].onMergedHull[(id - hull.firstId) % hull.blockSize] = true;
+        }
+    }
+    hull.changed = false;
+    return hull.faces;
+}
+
+#endif